@@ -0,0 +1,53 @@
+#ifndef ADAPTER_PLUGIN_ABI_H
+#define ADAPTER_PLUGIN_ABI_H
+
+/*
+ * C ABI for service adapters built as shared libraries and loaded with dlopen.
+ *
+ * A plugin exports one symbol, JT_ADAPTER_ENTRY_SYMBOL, returning a static table. The host
+ * checks abi_version, calls create once per OperationFactory that uses the service, and
+ * passes the returned handle to execute and, finally, destroy.
+ *
+ * execute returns one of the JT_ADAPTER_* status codes. On JT_ADAPTER_OK *response holds
+ * the reply; on JT_ADAPTER_FAILED it may hold an error message. Either way the host copies
+ * it and releases it with free_response. Strings are not NUL-terminated; lengths are bytes.
+ * A handle is only ever used by one thread at a time.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define JT_ADAPTER_ABI_VERSION 1
+#define JT_ADAPTER_ENTRY_SYMBOL "jt_adapter_entry"
+
+enum {
+    JT_ADAPTER_OK = 0,
+    JT_ADAPTER_UNSUPPORTED_OPERATION = 1,
+    JT_ADAPTER_FAILED = 2
+};
+
+typedef struct jt_adapter_api {
+    uint32_t abi_version;
+    void* (*create)(const char* service_name, size_t service_name_length);
+    void (*destroy)(void* adapter);
+    int (*execute)(void* adapter,
+                   const char* operation, size_t operation_length,
+                   const char* request, size_t request_length,
+                   const char* url, size_t url_length,
+                   char** response, size_t* response_length);
+    void (*free_response)(char* response);
+} jt_adapter_api;
+
+typedef const jt_adapter_api* (*jt_adapter_entry_fn)(void);
+
+const jt_adapter_api* jt_adapter_entry(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ADAPTER_PLUGIN_ABI_H */
@@ -0,0 +1,147 @@
+#ifndef ADAPTER_PLUGIN_H
+#define ADAPTER_PLUGIN_H
+
+#include "adapter_plugin.h"
+#include "operation_factory.hpp"
+
+#include <dlfcn.h>
+
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+
+// Define the PluginLibrary class: one dlopen-ed adapter library and its entry table.
+// Adapters hold a shared_ptr to it, so the library stays loaded until the last one is gone.
+class PluginLibrary {
+private:
+    void* handle = nullptr;
+    const jt_adapter_api* table = nullptr;
+
+public:
+    explicit PluginLibrary(const std::string& libraryPath) {
+        handle = ::dlopen(libraryPath.c_str(), RTLD_NOW | RTLD_LOCAL);
+        if (handle == nullptr) {
+            throw std::runtime_error("Cannot load adapter plugin " + libraryPath + ": " + ::dlerror());
+        }
+        auto entry = reinterpret_cast<jt_adapter_entry_fn>(::dlsym(handle, JT_ADAPTER_ENTRY_SYMBOL));
+        table = entry != nullptr ? entry() : nullptr;
+        if (table == nullptr || table->abi_version != JT_ADAPTER_ABI_VERSION || table->create == nullptr ||
+            table->destroy == nullptr || table->execute == nullptr || table->free_response == nullptr) {
+            ::dlclose(handle);
+            throw std::runtime_error("Adapter plugin " + libraryPath + " has no compatible " JT_ADAPTER_ENTRY_SYMBOL);
+        }
+    }
+
+    PluginLibrary(const PluginLibrary&) = delete;
+    PluginLibrary& operator=(const PluginLibrary&) = delete;
+
+    ~PluginLibrary() {
+        ::dlclose(handle);
+    }
+
+    const jt_adapter_api& api() const {
+        return *table;
+    }
+};
+
+// Define the PluginServiceAdapter class: a ServiceInterface over one plugin adapter handle.
+class PluginServiceAdapter : public ServiceInterface {
+private:
+    std::shared_ptr<PluginLibrary> library;
+    std::string serviceName;
+    void* adapter;
+
+    int call(const std::string& operationName, const std::string& request, const std::string& url, std::string& response) {
+        char* data = nullptr;
+        size_t length = 0;
+        int status = library->api().execute(adapter, operationName.data(), operationName.size(), request.data(), request.size(),
+                                            url.data(), url.size(), &data, &length);
+        if (data != nullptr) {
+            response.assign(data, length);
+            library->api().free_response(data);
+        }
+        return status;
+    }
+
+public:
+    PluginServiceAdapter(std::shared_ptr<PluginLibrary> library, const std::string& serviceName)
+        : library(std::move(library)), serviceName(serviceName) {
+        adapter = this->library->api().create(serviceName.data(), serviceName.size());
+        if (adapter == nullptr) {
+            throw std::runtime_error("Adapter plugin refused to create service " + serviceName);
+        }
+    }
+
+    PluginServiceAdapter(const PluginServiceAdapter&) = delete;
+    PluginServiceAdapter& operator=(const PluginServiceAdapter&) = delete;
+
+    ~PluginServiceAdapter() override {
+        library->api().destroy(adapter);
+    }
+
+    using ServiceInterface::execute;
+
+    std::string execute(const std::string& operationName, const std::string& request, const std::string& url) override {
+        std::string response;
+        switch (call(operationName, request, url, response)) {
+            case JT_ADAPTER_OK:
+                return response;
+            case JT_ADAPTER_UNSUPPORTED_OPERATION:
+                throw std::invalid_argument("Unsupported operation: " + operationName);
+            default:
+                throw std::runtime_error(serviceName + " " + operationName + " failed: " + response);
+        }
+    }
+
+    Expected<std::string> tryExecute(const std::string& operationName, const std::string& request, const std::string& url, const CallContext& context) override {
+        if (context.isCancelled()) {
+            return Error(ErrorCode::Cancelled, operationName);
+        }
+        if (context.isExpired()) {
+            return Error(ErrorCode::DeadlineExceeded, operationName);
+        }
+        std::string response;
+        switch (call(operationName, request, url, response)) {
+            case JT_ADAPTER_OK:
+                return response;
+            case JT_ADAPTER_UNSUPPORTED_OPERATION:
+                return Error(ErrorCode::UnsupportedOperation, operationName);
+            default:
+                return Error(ErrorCode::ServiceFailed, response);
+        }
+    }
+};
+
+// Function to register a service served by a plugin library. Nothing is loaded here: the
+// library is dlopen-ed when some factory first dispatches to the service, and is then shared
+// by every adapter built from this registration. A library that fails to load is not tried
+// again; every later dispatch to the service fails with the same error.
+inline void registerPlugin(AdapterRegistry& registry, const std::string& serviceName, const std::string& libraryPath) {
+    struct LazyLibrary {
+        std::mutex mutex;
+        std::shared_ptr<PluginLibrary> library;
+        std::string loadError;
+    };
+    auto lazy = std::make_shared<LazyLibrary>();
+    registry.registerFactory(serviceName, [lazy, serviceName, libraryPath]() -> std::unique_ptr<ServiceInterface> {
+        std::shared_ptr<PluginLibrary> library;
+        {
+            std::lock_guard<std::mutex> lock(lazy->mutex);
+            if (lazy->library == nullptr && lazy->loadError.empty()) {
+                try {
+                    lazy->library = std::make_shared<PluginLibrary>(libraryPath);
+                } catch (const std::runtime_error& e) {
+                    lazy->loadError = e.what();
+                }
+            }
+            if (lazy->library == nullptr) {
+                throw std::runtime_error(lazy->loadError);
+            }
+            library = lazy->library;
+        }
+        return std::make_unique<PluginServiceAdapter>(std::move(library), serviceName);
+    });
+}
+
+#endif // ADAPTER_PLUGIN_H
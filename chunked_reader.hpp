@@ -0,0 +1,121 @@
+#ifndef CHUNKED_READER_H
+#define CHUNKED_READER_H
+
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+
+// Define the ChunkedRecordReader class.
+// Splits a stream of JSON records (NDJSON or simply concatenated objects/arrays) that arrives
+// in chunks of any size. The scanner's state (nesting depth, inside-string, escape) is kept
+// between chunks, so every byte is looked at exactly once. A record that lies entirely within
+// one chunk is handed to the callback in place, with no copy; only a record that straddles a
+// chunk boundary is gathered into the carry buffer, which never grows beyond maxRecordBytes.
+class ChunkedRecordReader {
+private:
+    std::string carry;          // bytes of the record in flight from earlier chunks
+    size_t maxRecordBytes;
+    int depth = 0;
+    bool inString = false;
+    bool escaped = false;
+    bool inRecord = false;
+    size_t recordsEmitted = 0;
+    size_t recordsCopied = 0;
+
+    void appendToCarry(const char* data, size_t length) {
+        if (carry.size() + length > maxRecordBytes) {
+            reset();
+            throw std::length_error("JSON record exceeds " + std::to_string(maxRecordBytes) + " bytes");
+        }
+        carry.append(data, length);
+    }
+
+public:
+    explicit ChunkedRecordReader(size_t maxRecordBytes = 16 << 20) : maxRecordBytes(maxRecordBytes) {
+        carry.reserve(std::min<size_t>(maxRecordBytes, 64 << 10));
+    }
+
+    // Scan one chunk and call onRecord(char* data, int length) for every record it completes.
+    // The pointer is valid only during the callback. The chunk is writable because JsonPack
+    // parses in place.
+    template <typename OnRecord>
+    void feed(char* chunk, size_t length, OnRecord&& onRecord) {
+        size_t recordStart = 0;  // start of the current record within this chunk
+        for (size_t i = 0; i < length; ++i) {
+            char c = chunk[i];
+            if (!inRecord) {
+                if (c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == ',') {
+                    continue;
+                }
+                if (c != '{' && c != '[') {
+                    throw std::runtime_error(std::string("Unexpected byte between JSON records: '") + c + "'");
+                }
+                inRecord = true;
+                recordStart = i;
+                depth = 0;
+            }
+            if (inString) {
+                if (escaped) {
+                    escaped = false;
+                } else if (c == '\\') {
+                    escaped = true;
+                } else if (c == '"') {
+                    inString = false;
+                }
+                continue;
+            }
+            if (c == '"') {
+                inString = true;
+            } else if (c == '{' || c == '[') {
+                ++depth;
+            } else if ((c == '}' || c == ']') && --depth == 0) {
+                inRecord = false;
+                ++recordsEmitted;
+                if (carry.empty()) {
+                    onRecord(chunk + recordStart, static_cast<int>(i + 1 - recordStart));
+                } else {
+                    appendToCarry(chunk, i + 1);
+                    ++recordsCopied;
+                    onRecord(carry.data(), static_cast<int>(carry.size()));
+                    carry.clear();
+                }
+            }
+        }
+        if (inRecord) {
+            size_t from = carry.empty() ? recordStart : 0;
+            appendToCarry(chunk + from, length - from);
+        }
+    }
+
+    // Call at end of input; throws if a record was cut off.
+    void finish() {
+        if (inRecord) {
+            reset();
+            throw std::runtime_error("Input ended inside a JSON record");
+        }
+    }
+
+    void reset() {
+        carry.clear();
+        depth = 0;
+        inString = false;
+        escaped = false;
+        inRecord = false;
+    }
+
+    size_t records() const {
+        return recordsEmitted;
+    }
+
+    // Records that straddled a chunk boundary and had to be copied.
+    size_t copiedRecords() const {
+        return recordsCopied;
+    }
+
+    size_t bytesInFlight() const {
+        return carry.size();
+    }
+};
+
+#endif // CHUNKED_READER_H
@@ -0,0 +1,274 @@
+#ifndef CONCURRENCY_LIMITER_H
+#define CONCURRENCY_LIMITER_H
+
+#include "operation_factory.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+
+class ServiceOverloaded : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
+struct ConcurrencyPolicy {
+    int initialLimit = 16;
+    int minLimit = 1;
+    int maxLimit = 1000;
+    double tolerance = 1.5;                        // latency may reach tolerance x baseline before the limit shrinks
+    double smoothing = 0.2;                        // weight of each new limit estimate
+    double backoff = 0.9;                          // multiplicative decrease on a timed-out call
+    std::chrono::microseconds maxQueueWait{0};     // 0 sheds callers over the limit at once
+    int maxQueued = 64;                            // waiters beyond this are shed
+};
+
+// Define the AdaptiveLimiter class: a gradient-based concurrency limit for one service.
+// The baseline is the lowest latency seen over the last couple of thousand calls, i.e. the
+// counterparty's uncongested response time; a short moving average tracks current latency.
+// Each sample moves the limit toward  limit * min(1, tolerance * baseline / current) + sqrt(limit):
+// it grows while latency stays near the baseline and shrinks as soon as queueing at the
+// counterparty shows up. The limit does not grow while fewer than half the permits are in use,
+// and a timed-out call backs it off multiplicatively.
+// acquire/release are a CAS on an atomic counter; samples are folded into the estimate under a
+// try_lock, so a contended update is skipped rather than waited for. Queued callers (only when
+// maxQueueWait > 0) wait on a condition variable.
+class AdaptiveLimiter {
+public:
+    enum class Outcome { Success, Dropped, Ignored };
+    enum class Admission { Acquired, Shed, Expired, Cancelled };
+
+private:
+    const ConcurrencyPolicy policy;
+    std::atomic<int> limit;
+    std::atomic<int> inFlight{0};
+    std::atomic<int> waiting{0};
+    std::atomic<uint64_t> shed{0};
+    std::atomic<uint64_t> queued{0};
+
+    std::mutex estimateMutex;
+    static constexpr uint64_t kBaselineWindow = 1024;
+    double shortLatency = 0;   // microseconds
+    double baseline = 0;       // minimum over the previous and current windows
+    double windowMinimum = 0;
+    double estimate;
+    uint64_t samples = 0;
+
+    std::mutex waitMutex;
+    std::condition_variable slotFreed;
+
+    void setLimit(double newLimit) {
+        int clamped = static_cast<int>(std::clamp(newLimit, static_cast<double>(policy.minLimit), static_cast<double>(policy.maxLimit)));
+        int previous = limit.exchange(clamped);
+        if (clamped > previous && waiting.load() > 0) {
+            std::lock_guard<std::mutex> lock(waitMutex);
+            slotFreed.notify_all();
+        }
+    }
+
+    void sample(std::chrono::steady_clock::duration latency, int inFlightAtStart) {
+        std::unique_lock<std::mutex> lock(estimateMutex, std::try_to_lock);
+        if (!lock.owns_lock()) {
+            return;
+        }
+        double micros = std::max(1.0, std::chrono::duration<double, std::micro>(latency).count());
+        if (samples++ == 0) {
+            shortLatency = baseline = windowMinimum = micros;
+            return;
+        }
+        shortLatency += (micros - shortLatency) * 0.1;
+        windowMinimum = std::min(windowMinimum, micros);
+        baseline = std::min(baseline, micros);
+        if (samples % kBaselineWindow == 0) {
+            // Let the baseline rise if the counterparty has really become slower.
+            baseline = windowMinimum;
+            windowMinimum = micros;
+        }
+        double gradient = std::clamp(policy.tolerance * baseline / shortLatency, 0.5, 1.0);
+        if (gradient >= 1.0 && inFlightAtStart < estimate / 2) {
+            return;  // not limited by us; growing the limit would only hide later overload
+        }
+        double target = estimate * gradient + std::sqrt(estimate);
+        estimate = std::clamp(estimate * (1 - policy.smoothing) + target * policy.smoothing, static_cast<double>(policy.minLimit),
+                              static_cast<double>(policy.maxLimit));
+        setLimit(estimate);
+    }
+
+public:
+    explicit AdaptiveLimiter(ConcurrencyPolicy policy = ConcurrencyPolicy{})
+        : policy(policy), limit(policy.initialLimit), estimate(policy.initialLimit) {}
+
+    bool tryAcquire() {
+        int current = inFlight.load();
+        while (current < limit.load(std::memory_order_relaxed)) {
+            if (inFlight.compare_exchange_weak(current, current + 1)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Take a permit, queueing for up to maxQueueWait (and never past the call's deadline).
+    Admission acquire(const CallContext& context) {
+        if (tryAcquire()) {
+            return Admission::Acquired;
+        }
+        if (policy.maxQueueWait.count() <= 0 || waiting.load() >= policy.maxQueued) {
+            shed.fetch_add(1, std::memory_order_relaxed);
+            return Admission::Shed;
+        }
+        queued.fetch_add(1, std::memory_order_relaxed);
+        Deadline until = std::min(context.deadline, std::chrono::steady_clock::now() + policy.maxQueueWait);
+        std::unique_lock<std::mutex> lock(waitMutex);
+        waiting.fetch_add(1);
+        Admission result = Admission::Acquired;
+        while (!tryAcquire()) {
+            if (context.isCancelled()) {
+                result = Admission::Cancelled;
+                break;
+            }
+            if (slotFreed.wait_until(lock, std::min(until, std::chrono::steady_clock::now() + std::chrono::milliseconds(10))) ==
+                    std::cv_status::timeout &&
+                std::chrono::steady_clock::now() >= until) {
+                if (tryAcquire()) {
+                    break;
+                }
+                result = context.isExpired() ? Admission::Expired : Admission::Shed;
+                if (result == Admission::Shed) {
+                    shed.fetch_add(1, std::memory_order_relaxed);
+                }
+                break;
+            }
+        }
+        waiting.fetch_sub(1);
+        return result;
+    }
+
+    // Return a permit. inFlightAtStart is what inFlight() was when the call was admitted.
+    void release(std::chrono::steady_clock::duration latency, Outcome outcome, int inFlightAtStart) {
+        inFlight.fetch_sub(1);
+        if (waiting.load() > 0) {
+            std::lock_guard<std::mutex> lock(waitMutex);
+            slotFreed.notify_one();
+        }
+        if (outcome == Outcome::Success) {
+            sample(latency, inFlightAtStart);
+        } else if (outcome == Outcome::Dropped) {
+            std::lock_guard<std::mutex> lock(estimateMutex);
+            estimate = std::max(static_cast<double>(policy.minLimit), estimate * policy.backoff);
+            setLimit(estimate);
+        }
+    }
+
+    int currentLimit() const {
+        return limit.load(std::memory_order_relaxed);
+    }
+
+    int currentInFlight() const {
+        return inFlight.load(std::memory_order_relaxed);
+    }
+
+    uint64_t shedCount() const {
+        return shed.load(std::memory_order_relaxed);
+    }
+
+    uint64_t queuedCount() const {
+        return queued.load(std::memory_order_relaxed);
+    }
+
+    void report(const std::string& serviceName, std::ostream& out) const {
+        out << "limiter " << serviceName << ": limit " << currentLimit() << ", in flight " << currentInFlight() << ", queued "
+            << queuedCount() << ", shed " << shedCount() << std::endl;
+    }
+};
+
+// Define the LimitedService class: a ServiceInterface decorator that admits calls through an
+// AdaptiveLimiter. Share one limiter between every adapter instance for a service (see
+// limitService) so the limit covers all factories and shards together.
+class LimitedService : public ServiceInterface {
+private:
+    std::string serviceName;
+    std::unique_ptr<ServiceInterface> inner;
+    std::shared_ptr<AdaptiveLimiter> limiter;
+
+public:
+    LimitedService(std::string serviceName, std::unique_ptr<ServiceInterface> inner, std::shared_ptr<AdaptiveLimiter> limiter)
+        : serviceName(std::move(serviceName)), inner(std::move(inner)), limiter(std::move(limiter)) {}
+
+    std::string execute(const std::string& operationName, const std::string& request, const std::string& url) override {
+        return execute(operationName, request, url, CallContext{});
+    }
+
+    std::string execute(const std::string& operationName, const std::string& request, const std::string& url, const CallContext& context) override {
+        switch (limiter->acquire(context)) {
+            case AdaptiveLimiter::Admission::Acquired:
+                break;
+            case AdaptiveLimiter::Admission::Cancelled:
+                throw CallCancelled(operationName + " cancelled");
+            case AdaptiveLimiter::Admission::Expired:
+                throw DeadlineExceeded(operationName + " exceeded its deadline");
+            case AdaptiveLimiter::Admission::Shed:
+                throw ServiceOverloaded(serviceName + " is over its concurrency limit of " + std::to_string(limiter->currentLimit()));
+        }
+        int inFlightAtStart = limiter->currentInFlight();
+        auto start = std::chrono::steady_clock::now();
+        try {
+            std::string response = inner->execute(operationName, request, url, context);
+            limiter->release(std::chrono::steady_clock::now() - start, AdaptiveLimiter::Outcome::Success, inFlightAtStart);
+            return response;
+        } catch (const DeadlineExceeded&) {
+            limiter->release(std::chrono::steady_clock::now() - start, AdaptiveLimiter::Outcome::Dropped, inFlightAtStart);
+            throw;
+        } catch (...) {
+            limiter->release(std::chrono::steady_clock::now() - start, AdaptiveLimiter::Outcome::Ignored, inFlightAtStart);
+            throw;
+        }
+    }
+
+    Expected<std::string> tryExecute(const std::string& operationName, const std::string& request, const std::string& url, const CallContext& context) override {
+        switch (limiter->acquire(context)) {
+            case AdaptiveLimiter::Admission::Acquired:
+                break;
+            case AdaptiveLimiter::Admission::Cancelled:
+                return Error(ErrorCode::Cancelled, operationName);
+            case AdaptiveLimiter::Admission::Expired:
+                return Error(ErrorCode::DeadlineExceeded, operationName);
+            case AdaptiveLimiter::Admission::Shed:
+                return Error(ErrorCode::Overloaded, serviceName);
+        }
+        int inFlightAtStart = limiter->currentInFlight();
+        auto start = std::chrono::steady_clock::now();
+        Expected<std::string> response = inner->tryExecute(operationName, request, url, context);
+        AdaptiveLimiter::Outcome outcome = AdaptiveLimiter::Outcome::Success;
+        if (!response) {
+            outcome = response.error().code() == ErrorCode::DeadlineExceeded ? AdaptiveLimiter::Outcome::Dropped : AdaptiveLimiter::Outcome::Ignored;
+        }
+        limiter->release(std::chrono::steady_clock::now() - start, outcome, inFlightAtStart);
+        return response;
+    }
+};
+
+// Function to put a registered service behind a limiter: every adapter the registry builds for
+// it from now on is wrapped in a LimitedService sharing that limiter.
+inline std::shared_ptr<AdaptiveLimiter> limitService(AdapterRegistry& registry, const std::string& serviceName,
+                                                     ConcurrencyPolicy policy = ConcurrencyPolicy{}) {
+    AdapterRegistry::AdapterFactory innerFactory = registry.factoryFor(serviceName);
+    if (!innerFactory) {
+        throw std::invalid_argument("Unsupported service: " + serviceName);
+    }
+    auto limiter = std::make_shared<AdaptiveLimiter>(policy);
+    registry.registerFactory(serviceName, [serviceName, innerFactory, limiter]() -> std::unique_ptr<ServiceInterface> {
+        return std::make_unique<LimitedService>(serviceName, innerFactory(), limiter);
+    });
+    return limiter;
+}
+
+#endif // CONCURRENCY_LIMITER_H
@@ -0,0 +1,194 @@
+#ifndef DEDUP_CACHE_H
+#define DEDUP_CACHE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Function to hash a raw record: 8 bytes per step with a multiply-xorshift mix.
+// Not cryptographic; DedupCache pairs it with the record length.
+inline uint64_t hashRecord(const char* data, size_t length, uint64_t seed = 0x9e3779b97f4a7c15ULL) {
+    const uint64_t k = 0xff51afd7ed558ccdULL;
+    uint64_t hash = seed ^ (length * k);
+    size_t i = 0;
+    for (; i + 8 <= length; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, data + i, 8);
+        word *= k;
+        word ^= word >> 33;
+        hash = (hash ^ word) * 0xc4ceb9fe1a85ec53ULL;
+        hash ^= hash >> 29;
+    }
+    uint64_t tail = 0;
+    std::memcpy(&tail, data + i, length - i);
+    hash = (hash ^ (tail * k)) * 0xc4ceb9fe1a85ec53ULL;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+struct DedupStats {
+    uint64_t lookups = 0;
+    uint64_t hits = 0;
+    uint64_t insertions = 0;
+    uint64_t evictions = 0;     // removed to stay within the byte budget
+    uint64_t expirations = 0;   // found older than maxAge on lookup
+    uint64_t replacements = 0;  // overwritten by an insert with the same key
+    size_t entries = 0;
+    size_t bytes = 0;
+
+    double hitRate() const {
+        return lookups == 0 ? 0.0 : static_cast<double>(hits) / lookups;
+    }
+};
+
+// Define the DedupCache class: transformed outputs keyed by (mapping version, record hash, length).
+// The cache is split into independently locked shards, each an LRU bounded by bytes; entries
+// older than maxAge are treated as misses. Bump the mapping version whenever the mapping
+// changes so stale outputs are never reused.
+class DedupCache {
+private:
+    struct Key {
+        uint64_t mappingVersion;
+        uint64_t hash;
+        uint64_t length;
+
+        bool operator==(const Key& other) const {
+            return mappingVersion == other.mappingVersion && hash == other.hash && length == other.length;
+        }
+    };
+
+    struct KeyHash {
+        size_t operator()(const Key& key) const {
+            return static_cast<size_t>(key.hash ^ (key.mappingVersion * 0x9e3779b97f4a7c15ULL));
+        }
+    };
+
+    struct Entry {
+        Key key;
+        std::string output;
+        std::chrono::steady_clock::time_point inserted;
+    };
+
+    struct Shard {
+        std::mutex mutex;
+        std::list<Entry> lru;  // most recently used first
+        std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> index;
+        size_t bytes = 0;
+    };
+
+    static constexpr size_t kEntryOverhead = sizeof(Entry) + 4 * sizeof(void*);
+
+    std::vector<std::unique_ptr<Shard>> shards;
+    size_t maxBytesPerShard;
+    std::chrono::steady_clock::duration maxAge;
+    std::atomic<uint64_t> lookups{0};
+    std::atomic<uint64_t> hits{0};
+    std::atomic<uint64_t> insertions{0};
+    std::atomic<uint64_t> evictions{0};
+    std::atomic<uint64_t> expirations{0};
+    std::atomic<uint64_t> replacements{0};
+
+    Shard& shardFor(uint64_t hash) {
+        return *shards[(hash >> 48) % shards.size()];
+    }
+
+    // Remove an entry; the caller counts why.
+    void erase(Shard& shard, std::list<Entry>::iterator it) {
+        shard.bytes -= it->output.size() + kEntryOverhead;
+        shard.index.erase(it->key);
+        shard.lru.erase(it);
+    }
+
+public:
+    explicit DedupCache(size_t maxBytes = 64 << 20, std::chrono::steady_clock::duration maxAge = std::chrono::minutes(5), size_t shardCount = 16)
+        : maxBytesPerShard(maxBytes / (shardCount == 0 ? 1 : shardCount)), maxAge(maxAge) {
+        for (size_t i = 0; i < (shardCount == 0 ? 1 : shardCount); ++i) {
+            shards.push_back(std::make_unique<Shard>());
+        }
+    }
+
+    // Callers that look up and then insert should hash once with hashRecord and pass the hash.
+    std::optional<std::string> lookup(uint64_t mappingVersion, uint64_t hash, size_t length) {
+        lookups.fetch_add(1, std::memory_order_relaxed);
+        Key key{mappingVersion, hash, length};
+        Shard& shard = shardFor(key.hash);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto found = shard.index.find(key);
+        if (found == shard.index.end()) {
+            return std::nullopt;
+        }
+        if (std::chrono::steady_clock::now() - found->second->inserted > maxAge) {
+            erase(shard, found->second);
+            expirations.fetch_add(1, std::memory_order_relaxed);
+            return std::nullopt;
+        }
+        shard.lru.splice(shard.lru.begin(), shard.lru, found->second);
+        hits.fetch_add(1, std::memory_order_relaxed);
+        return found->second->output;
+    }
+
+    std::optional<std::string> lookup(uint64_t mappingVersion, const char* record, size_t length) {
+        return lookup(mappingVersion, hashRecord(record, length), length);
+    }
+
+    void insert(uint64_t mappingVersion, uint64_t hash, size_t length, std::string output) {
+        Key key{mappingVersion, hash, length};
+        size_t cost = output.size() + kEntryOverhead;
+        if (cost > maxBytesPerShard) {
+            return;
+        }
+        Shard& shard = shardFor(key.hash);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto found = shard.index.find(key);
+        if (found != shard.index.end()) {
+            erase(shard, found->second);
+            replacements.fetch_add(1, std::memory_order_relaxed);
+        }
+        while (!shard.lru.empty() && shard.bytes + cost > maxBytesPerShard) {
+            erase(shard, std::prev(shard.lru.end()));
+            evictions.fetch_add(1, std::memory_order_relaxed);
+        }
+        shard.lru.push_front({key, std::move(output), std::chrono::steady_clock::now()});
+        shard.index.emplace(key, shard.lru.begin());
+        shard.bytes += cost;
+        insertions.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void insert(uint64_t mappingVersion, const char* record, size_t length, std::string output) {
+        insert(mappingVersion, hashRecord(record, length), length, std::move(output));
+    }
+
+    DedupStats stats() {
+        DedupStats result;
+        result.lookups = lookups.load();
+        result.hits = hits.load();
+        result.insertions = insertions.load();
+        result.evictions = evictions.load();
+        result.expirations = expirations.load();
+        result.replacements = replacements.load();
+        for (auto& shard : shards) {
+            std::lock_guard<std::mutex> lock(shard->mutex);
+            result.entries += shard->lru.size();
+            result.bytes += shard->bytes;
+        }
+        return result;
+    }
+
+    void report(std::ostream& out) {
+        DedupStats s = stats();
+        out << "dedup: " << s.lookups << " lookups, " << s.hits << " hits (" << s.hitRate() * 100 << "%), " << s.entries
+            << " entries, " << s.bytes / 1024 << " KiB, " << s.evictions << " evictions, " << s.expirations << " expired, "
+            << s.replacements << " replaced" << std::endl;
+    }
+};
+
+#endif // DEDUP_CACHE_H
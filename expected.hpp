@@ -0,0 +1,157 @@
+#ifndef EXPECTED_H
+#define EXPECTED_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <variant>
+
+enum class ErrorCode {
+    KeyNotFound,
+    IndexOutOfBounds,
+    NotAnObject,
+    NotAnArray,
+    InvalidPath,
+    InvalidArrayToken,
+    UnsupportedOperation,
+    UnsupportedService,
+    DeadlineExceeded,
+    Cancelled,
+    ServiceFailed,
+    Overloaded,
+    InvalidUtf8,
+    InvalidEscape,
+    ControlCharacter,
+};
+
+// Define the Error class: an error code plus the offending token.
+// Nothing is allocated when an error is created; message() formats the text only when asked,
+// so a caller that just checks the code pays no string cost on a miss.
+class Error {
+private:
+    static constexpr size_t kMaxDetail = 47;
+
+    ErrorCode errorCode;
+    size_t index = 0;
+    unsigned char detailLength = 0;
+    bool truncated = false;
+    char detail[kMaxDetail + 1];
+
+public:
+    explicit Error(ErrorCode code, std::string_view token = {}, size_t index = 0) : errorCode(code), index(index) {
+        size_t length = std::min(token.size(), kMaxDetail);
+        std::memcpy(detail, token.data(), length);
+        detailLength = static_cast<unsigned char>(length);
+        truncated = token.size() > kMaxDetail;
+    }
+
+    ErrorCode code() const {
+        return errorCode;
+    }
+
+    std::string_view token() const {
+        return {detail, detailLength};
+    }
+
+    std::string message() const {
+        std::string token(detail, detailLength);
+        if (truncated) {
+            token += "...";
+        }
+        switch (errorCode) {
+            case ErrorCode::KeyNotFound:
+                return "Invalid path: key '" + token + "' not found";
+            case ErrorCode::IndexOutOfBounds:
+                return "Invalid path: array index " + std::to_string(index) + " out of bounds at '" + token + "'";
+            case ErrorCode::NotAnObject:
+                return "Invalid path: '" + token + "' is not an object";
+            case ErrorCode::NotAnArray:
+                return "Invalid path: '" + token + "' is not an array";
+            case ErrorCode::InvalidPath:
+                return "Invalid path: " + token;
+            case ErrorCode::InvalidArrayToken:
+                return "Invalid array token: " + token;
+            case ErrorCode::UnsupportedOperation:
+                return "Unsupported operation: " + token;
+            case ErrorCode::UnsupportedService:
+                return "Unsupported service: " + token;
+            case ErrorCode::DeadlineExceeded:
+                return token + " exceeded its deadline";
+            case ErrorCode::Cancelled:
+                return token + " cancelled";
+            case ErrorCode::ServiceFailed:
+                return "Service call failed: " + token;
+            case ErrorCode::Overloaded:
+                return token + " is over its concurrency limit";
+            case ErrorCode::InvalidUtf8:
+                return "Invalid UTF-8 at byte " + std::to_string(index) + " of '" + token + "'";
+            case ErrorCode::InvalidEscape:
+                return "Invalid escape at byte " + std::to_string(index) + " of '" + token + "'";
+            case ErrorCode::ControlCharacter:
+                return "Unescaped control character at byte " + std::to_string(index) + " of '" + token + "'";
+        }
+        return "Unknown error";
+    }
+};
+
+// Define the Expected class: a value or an Error, in the spirit of C++23 std::expected.
+template <typename T>
+class Expected {
+private:
+    std::variant<T, Error> storage;
+
+public:
+    Expected(T value) : storage(std::in_place_index<0>, std::move(value)) {}
+    Expected(Error error) : storage(std::in_place_index<1>, std::move(error)) {}
+
+    bool hasValue() const {
+        return storage.index() == 0;
+    }
+
+    explicit operator bool() const {
+        return hasValue();
+    }
+
+    T& value() & {
+        if (!hasValue()) {
+            throw std::runtime_error(error().message());
+        }
+        return std::get<0>(storage);
+    }
+
+    const T& value() const& {
+        if (!hasValue()) {
+            throw std::runtime_error(error().message());
+        }
+        return std::get<0>(storage);
+    }
+
+    T&& value() && {
+        if (!hasValue()) {
+            throw std::runtime_error(error().message());
+        }
+        return std::get<0>(std::move(storage));
+    }
+
+    T& operator*() {
+        return std::get<0>(storage);
+    }
+
+    const T& operator*() const {
+        return std::get<0>(storage);
+    }
+
+    const Error& error() const {
+        return std::get<1>(storage);
+    }
+
+    T valueOr(T fallback) const {
+        return hasValue() ? std::get<0>(storage) : std::move(fallback);
+    }
+};
+
+#endif // EXPECTED_H
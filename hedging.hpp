@@ -0,0 +1,251 @@
+#ifndef HEDGING_H
+#define HEDGING_H
+
+#include "operation_factory.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+struct HedgingPolicy {
+    double percentile = 0.95;                              // hedge after this percentile of recent latency
+    std::chrono::microseconds minDelay{200};               // never hedge sooner than this
+    std::chrono::microseconds initialDelay{10000};         // used until minSamples have been seen
+    size_t window = 1024;                                  // recent latencies kept
+    size_t minSamples = 64;
+    size_t workerThreads = 8;
+    std::unordered_set<std::string> idempotentOperations{"read"};
+};
+
+// Define the LatencyTracker class: a sliding window of recent latencies.
+// The hedge delay is recomputed every few samples so the call path only reads an atomic.
+class LatencyTracker {
+private:
+    std::mutex mutex;
+    std::vector<int64_t> samples;
+    size_t next = 0;
+    size_t count = 0;
+    size_t sinceRecompute = 0;
+    const HedgingPolicy& policy;
+    std::atomic<int64_t> delayMicros;
+
+public:
+    explicit LatencyTracker(const HedgingPolicy& policy)
+        : samples(policy.window), policy(policy), delayMicros(policy.initialDelay.count()) {}
+
+    void record(std::chrono::steady_clock::duration latency) {
+        std::lock_guard<std::mutex> lock(mutex);
+        samples[next] = std::chrono::duration_cast<std::chrono::microseconds>(latency).count();
+        next = (next + 1) % samples.size();
+        count = std::min(count + 1, samples.size());
+        if (count >= policy.minSamples && ++sinceRecompute >= std::max<size_t>(1, samples.size() / 16)) {
+            sinceRecompute = 0;
+            std::vector<int64_t> sorted(samples.begin(), samples.begin() + count);
+            size_t rank = std::min(count - 1, static_cast<size_t>(policy.percentile * count));
+            std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+            delayMicros.store(std::max<int64_t>(sorted[rank], policy.minDelay.count()), std::memory_order_relaxed);
+        }
+    }
+
+    std::chrono::microseconds hedgeDelay() const {
+        return std::chrono::microseconds(delayMicros.load(std::memory_order_relaxed));
+    }
+};
+
+// Define the HedgedService class.
+// Wraps a thread-safe ServiceInterface (e.g. HttpServiceAdapter). For idempotent operations, if
+// the first attempt has not answered within the tracked latency percentile, a duplicate is sent;
+// the first reply wins and the other attempt is cancelled through its CallContext.
+class HedgedService : public ServiceInterface {
+private:
+    struct Race {
+        std::mutex mutex;
+        std::condition_variable finished;
+        bool done = false;
+        int launched = 0;
+        int failures = 0;
+        int winner = -1;
+        std::string result;
+        std::exception_ptr lastError;
+        std::atomic<bool> cancel[2] = {false, false};
+    };
+
+    std::shared_ptr<ServiceInterface> inner;
+    HedgingPolicy policy;
+    LatencyTracker tracker;
+
+    std::mutex poolMutex;
+    std::condition_variable poolWake;
+    std::deque<std::function<void()>> tasks;
+    std::vector<std::thread> workers;
+    size_t idleWorkers = 0;
+    bool stopping = false;
+
+    std::atomic<uint64_t> calls{0};
+    std::atomic<uint64_t> hedges{0};
+    std::atomic<uint64_t> hedgeWins{0};
+
+    void workerLoop() {
+        std::unique_lock<std::mutex> lock(poolMutex);
+        for (;;) {
+            ++idleWorkers;
+            poolWake.wait(lock, [this] { return stopping || !tasks.empty(); });
+            --idleWorkers;
+            if (tasks.empty()) {
+                return;
+            }
+            std::function<void()> task = std::move(tasks.front());
+            tasks.pop_front();
+            lock.unlock();
+            task();
+            lock.lock();
+        }
+    }
+
+    // Queue an attempt; with requireIdle, give up instead of queueing behind busy workers.
+    bool launch(const std::shared_ptr<Race>& race, int attempt, const std::string& operationName, const std::string& request,
+                const std::string& url, Deadline deadline, bool requireIdle) {
+        {
+            std::lock_guard<std::mutex> lock(poolMutex);
+            if (requireIdle && idleWorkers <= tasks.size()) {
+                return false;
+            }
+            {
+                std::lock_guard<std::mutex> raceLock(race->mutex);
+                ++race->launched;
+            }
+            tasks.emplace_back([this, race, attempt, operationName, request, url, deadline] {
+                CallContext context{deadline, &race->cancel[attempt]};
+                auto start = std::chrono::steady_clock::now();
+                try {
+                    std::string response = inner->execute(operationName, request, url, context);
+                    tracker.record(std::chrono::steady_clock::now() - start);
+                    std::lock_guard<std::mutex> raceLock(race->mutex);
+                    if (!race->done) {
+                        race->done = true;
+                        race->winner = attempt;
+                        race->result = std::move(response);
+                    }
+                } catch (...) {
+                    std::lock_guard<std::mutex> raceLock(race->mutex);
+                    ++race->failures;
+                    race->lastError = std::current_exception();
+                }
+                race->finished.notify_all();
+            });
+        }
+        poolWake.notify_one();
+        return true;
+    }
+
+public:
+    HedgedService(std::shared_ptr<ServiceInterface> inner, HedgingPolicy hedgingPolicy = HedgingPolicy{})
+        : inner(std::move(inner)), policy(std::move(hedgingPolicy)), tracker(policy) {
+        for (size_t i = 0; i < std::max<size_t>(2, policy.workerThreads); ++i) {
+            workers.emplace_back([this] { workerLoop(); });
+        }
+    }
+
+    HedgedService(const HedgedService&) = delete;
+    HedgedService& operator=(const HedgedService&) = delete;
+
+    ~HedgedService() {
+        {
+            std::lock_guard<std::mutex> lock(poolMutex);
+            stopping = true;
+        }
+        poolWake.notify_all();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+
+    std::string execute(const std::string& operationName, const std::string& request, const std::string& url) override {
+        return execute(operationName, request, url, CallContext{});
+    }
+
+    std::string execute(const std::string& operationName, const std::string& request, const std::string& url, const CallContext& context) override {
+        calls.fetch_add(1, std::memory_order_relaxed);
+        if (policy.idempotentOperations.count(operationName) == 0) {
+            auto start = std::chrono::steady_clock::now();
+            std::string response = inner->execute(operationName, request, url, context);
+            tracker.record(std::chrono::steady_clock::now() - start);
+            return response;
+        }
+
+        auto race = std::make_shared<Race>();
+        launch(race, 0, operationName, request, url, context.deadline, false);
+        Deadline hedgeAt = std::min(context.deadline, std::chrono::steady_clock::now() + tracker.hedgeDelay());
+        bool hedged = false;
+
+        std::unique_lock<std::mutex> lock(race->mutex);
+        for (;;) {
+            if (race->done || race->failures == race->launched) {
+                break;
+            }
+            auto now = std::chrono::steady_clock::now();
+            if (context.cancelled != nullptr && context.cancelled->load(std::memory_order_relaxed)) {
+                break;
+            }
+            if (now >= context.deadline) {
+                break;
+            }
+            if (!hedged && now >= hedgeAt) {
+                hedged = true;
+                lock.unlock();
+                if (launch(race, 1, operationName, request, url, context.deadline, true)) {
+                    hedges.fetch_add(1, std::memory_order_relaxed);
+                }
+                lock.lock();
+                continue;
+            }
+            // Wake periodically so an outer cancellation is noticed.
+            Deadline wakeAt = std::min({hedged ? context.deadline : hedgeAt, context.deadline, now + std::chrono::milliseconds(10)});
+            race->finished.wait_until(lock, wakeAt);
+        }
+
+        race->cancel[0].store(true, std::memory_order_relaxed);
+        race->cancel[1].store(true, std::memory_order_relaxed);
+        if (race->done) {
+            if (race->winner == 1) {
+                hedgeWins.fetch_add(1, std::memory_order_relaxed);
+            }
+            return std::move(race->result);
+        }
+        if (race->failures == race->launched && race->lastError) {
+            std::rethrow_exception(race->lastError);
+        }
+        lock.unlock();
+        context.check(operationName);
+        throw DeadlineExceeded(operationName + " exceeded its deadline");
+    }
+
+    uint64_t callCount() const {
+        return calls.load();
+    }
+
+    uint64_t hedgeCount() const {
+        return hedges.load();
+    }
+
+    uint64_t hedgeWinCount() const {
+        return hedgeWins.load();
+    }
+
+    std::chrono::microseconds currentHedgeDelay() const {
+        return tracker.hedgeDelay();
+    }
+};
+
+#endif // HEDGING_H
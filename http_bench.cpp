@@ -0,0 +1,132 @@
+#include "hedging.hpp"
+#include "http_transport.hpp"
+#include "mock_http_server.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Compare per-call connections, pooled keep-alive connections and pipelining against the
+// loopback mock server, going through the same ServiceInterface the factory uses; then measure
+// hedging and deadlines against a mock whose latency has a slow tail.
+// Usage: http_bench [calls]
+
+static void report(const std::string& label, std::vector<double>& micros, uint64_t connections) {
+    std::sort(micros.begin(), micros.end());
+    double total = 0;
+    for (double m : micros) {
+        total += m;
+    }
+    std::cout << label << ": mean " << total / micros.size() << " us, p50 " << micros[micros.size() / 2]
+              << " us, p99 " << micros[micros.size() * 99 / 100] << " us, connections opened " << connections << std::endl;
+}
+
+static void runAdapter(const std::string& label, bool reuseConnections, int calls) {
+    MockHttpServer server;
+    OperationFactory factory;
+    factory.registerService("OEPY", std::make_unique<HttpServiceAdapter>("OEPY", std::make_shared<HttpClient>(reuseConnections)));
+    std::string url = server.baseUrl() + "/oe/api/create";
+    std::vector<double> micros;
+    for (int i = 0; i < calls; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        std::string response = factory.dispatch("OEPY", "create", url, "Create Request Data");
+        micros.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+        if (response != "create at /oe/api/create: Create Request Data") {
+            throw std::runtime_error("Unexpected response: " + response);
+        }
+    }
+    report(label, micros, server.connections());
+}
+
+static void runPipelined(int calls, int depth) {
+    MockHttpServer server;
+    HttpClient client;
+    std::vector<HttpRequest> batch(depth);
+    for (auto& request : batch) {
+        request.url = server.baseUrl() + "/oe/api/read";
+        request.body = "Read Request Data";
+        request.headers.emplace_back("X-Operation", "read");
+    }
+    std::vector<double> micros;
+    for (int i = 0; i < calls; i += depth) {
+        auto start = std::chrono::steady_clock::now();
+        std::vector<HttpResponse> responses = client.sendPipelined(batch);
+        double elapsed = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+        for (size_t r = 0; r < responses.size(); ++r) {
+            micros.push_back(elapsed / depth);
+        }
+    }
+    report("pipelined x" + std::to_string(depth) + " (per call)", micros, server.connections());
+}
+
+// One call in fifty takes slowMicros; the rest take about 100us.
+static MockHttpServer::Handler slowTail(int slowMicros) {
+    auto counter = std::make_shared<std::atomic<uint64_t>>(0);
+    return MockHttpServer::withLatency(MockHttpServer::echoHandler(), [counter, slowMicros] {
+        return std::chrono::microseconds(counter->fetch_add(1) % 50 == 49 ? slowMicros : 100);
+    });
+}
+
+static void runHedging(const std::string& label, bool hedge, int calls) {
+    MockHttpServer server(slowTail(20000));
+    auto adapter = std::make_shared<HttpServiceAdapter>("OEPY", std::make_shared<HttpClient>());
+    HedgedService* hedged = nullptr;
+    OperationFactory factory;
+    if (hedge) {
+        auto service = std::make_unique<HedgedService>(adapter);
+        hedged = service.get();
+        factory.registerService("OEPY", std::move(service));
+    } else {
+        factory.registerService("OEPY", std::make_unique<HttpServiceAdapter>("OEPY", std::make_shared<HttpClient>()));
+    }
+    std::string url = server.baseUrl() + "/oe/api/read";
+    std::vector<double> micros;
+    for (int i = 0; i < calls; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        factory.dispatch("OEPY", "read", url, "Read Request Data");
+        micros.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+    }
+    report(label, micros, server.connections());
+    if (hedged != nullptr) {
+        std::cout << "  hedges sent " << hedged->hedgeCount() << ", won " << hedged->hedgeWinCount()
+                  << ", hedge delay " << hedged->currentHedgeDelay().count() << " us" << std::endl;
+    }
+}
+
+static void runDeadlines(int calls) {
+    MockHttpServer server(slowTail(20000));
+    OperationFactory factory;
+    factory.registerService("OEPY", std::make_unique<HttpServiceAdapter>("OEPY", std::make_shared<HttpClient>()));
+    std::string url = server.baseUrl() + "/oe/api/read";
+    int expired = 0;
+    std::vector<double> micros;
+    for (int i = 0; i < calls; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        try {
+            factory.dispatch("OEPY", "read", url, "Read Request Data", CallContext::withTimeout(std::chrono::milliseconds(2)));
+        } catch (const DeadlineExceeded&) {
+            ++expired;
+        }
+        micros.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+    }
+    report("2ms deadline (" + std::to_string(expired) + " expired)", micros, server.connections());
+}
+
+int main(int argc, char** argv) {
+    int calls = argc > 1 ? std::stoi(argv[1]) : 10000;
+    try {
+        runAdapter("new connection per call", false, calls);
+        runAdapter("pooled keep-alive", true, calls);
+        runPipelined(calls, 16);
+        runHedging("slow tail, no hedging", false, calls / 5);
+        runHedging("slow tail, hedged", true, calls / 5);
+        runDeadlines(calls / 5);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,483 @@
+#ifndef HTTP_TRANSPORT_H
+#define HTTP_TRANSPORT_H
+
+#include "operation_factory.hpp"
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cctype>
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Define the HttpUrl struct: the parts of an http:// URL the transport needs.
+struct HttpUrl {
+    std::string host;
+    std::string port = "80";
+    std::string path = "/";
+
+    static HttpUrl parse(const std::string& url) {
+        const std::string scheme = "http://";
+        if (url.compare(0, scheme.size(), scheme) != 0) {
+            throw std::invalid_argument("Unsupported URL (only http:// is supported): " + url);
+        }
+        HttpUrl result;
+        size_t hostStart = scheme.size();
+        size_t pathStart = url.find('/', hostStart);
+        std::string authority = url.substr(hostStart, pathStart == std::string::npos ? std::string::npos : pathStart - hostStart);
+        size_t colon = authority.rfind(':');
+        if (colon != std::string::npos) {
+            result.host = authority.substr(0, colon);
+            result.port = authority.substr(colon + 1);
+        } else {
+            result.host = authority;
+        }
+        if (pathStart != std::string::npos) {
+            result.path = url.substr(pathStart);
+        }
+        if (result.host.empty()) {
+            throw std::invalid_argument("Invalid URL: " + url);
+        }
+        return result;
+    }
+
+    std::string hostKey() const {
+        return host + ":" + port;
+    }
+};
+
+struct HttpRequest {
+    std::string method = "POST";
+    std::string url;
+    std::string body;
+    std::vector<std::pair<std::string, std::string>> headers;
+    // Resend on a fresh connection when a pooled one turns out to be closed. Idempotent methods
+    // always are; set this for other requests only if the server tolerates a duplicate.
+    bool retryIfStale = false;
+
+    bool retryable() const {
+        return retryIfStale || method == "GET" || method == "HEAD" || method == "PUT" || method == "DELETE" || method == "OPTIONS";
+    }
+};
+
+struct HttpResponse {
+    int status = 0;
+    std::string body;
+    bool keepAlive = true;
+};
+
+// Define the HttpConnection class: one keep-alive TCP connection to a host.
+class HttpConnection {
+private:
+    int fd = -1;
+    std::string readBuffer;
+    size_t readPos = 0;
+    bool receivedAny = false;
+
+    // Wait until the socket is ready for events, waking every few milliseconds to honour the
+    // call's deadline and cancellation flag; throws once either trips.
+    void await(short events, const CallContext& context) {
+        context.check("HTTP call");
+        int waitMs = 10;
+        if (context.hasDeadline()) {
+            auto remainingMs = std::chrono::duration_cast<std::chrono::milliseconds>(context.remaining()).count();
+            waitMs = static_cast<int>(std::clamp<long long>(remainingMs + 1, 0, waitMs));
+        }
+        pollfd waiter{fd, events, 0};
+        ::poll(&waiter, 1, waitMs);
+    }
+
+    // Connect the non-blocking socket fd, waiting no longer than the call's deadline.
+    bool connectWithin(const addrinfo& address, const CallContext& context) {
+        if (::connect(fd, address.ai_addr, address.ai_addrlen) == 0) {
+            return true;
+        }
+        if (errno != EINPROGRESS && errno != EINTR) {
+            return false;
+        }
+        for (;;) {
+            pollfd waiter{fd, POLLOUT, 0};
+            if (::poll(&waiter, 1, 0) > 0) {
+                int error = 0;
+                socklen_t length = sizeof(error);
+                ::getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &length);
+                return error == 0;
+            }
+            await(POLLOUT, context);
+        }
+    }
+
+    bool fill(const CallContext& context) {
+        if (readPos > 0 && readPos == readBuffer.size()) {
+            readBuffer.clear();
+            readPos = 0;
+        }
+        char chunk[16384];
+        for (;;) {
+            context.check("HTTP call");
+            ssize_t n = ::recv(fd, chunk, sizeof(chunk), MSG_DONTWAIT);
+            if (n > 0) {
+                readBuffer.append(chunk, static_cast<size_t>(n));
+                receivedAny = true;
+                return true;
+            }
+            if (n == 0) {
+                return false;
+            }
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                throw std::runtime_error(std::string("recv failed: ") + std::strerror(errno));
+            }
+            await(POLLIN, context);
+        }
+    }
+
+    std::string readLine(const CallContext& context) {
+        for (;;) {
+            size_t eol = readBuffer.find("\r\n", readPos);
+            if (eol != std::string::npos) {
+                std::string line = readBuffer.substr(readPos, eol - readPos);
+                readPos = eol + 2;
+                return line;
+            }
+            if (!fill(context)) {
+                throw std::runtime_error("Connection closed while reading response");
+            }
+        }
+    }
+
+    std::string readExactly(size_t length, const CallContext& context) {
+        while (readBuffer.size() - readPos < length) {
+            if (!fill(context)) {
+                throw std::runtime_error("Connection closed while reading response body");
+            }
+        }
+        std::string data = readBuffer.substr(readPos, length);
+        readPos += length;
+        return data;
+    }
+
+    // Parse a whole decimal or hex field of the response head; anything else is a protocol error.
+    static size_t parseNumber(const std::string& text, int base, const char* what) {
+        size_t value = 0;
+        const char* end = text.data() + text.size();
+        auto result = std::from_chars(text.data(), end, value, base);
+        if (result.ec != std::errc() || result.ptr == text.data() || (result.ptr != end && *result.ptr != ';' && *result.ptr != ' ')) {
+            throw std::runtime_error(std::string("Malformed ") + what + ": " + text);
+        }
+        return value;
+    }
+
+public:
+    const std::string hostKey;
+
+    // The socket is non-blocking; connecting, writing and reading all give up at the deadline.
+    HttpConnection(const HttpUrl& url, const CallContext& context) : hostKey(url.hostKey()) {
+        addrinfo hints{};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        addrinfo* found = nullptr;
+        int rc = ::getaddrinfo(url.host.c_str(), url.port.c_str(), &hints, &found);
+        if (rc != 0) {
+            throw std::runtime_error("Cannot resolve " + url.host + ": " + gai_strerror(rc));
+        }
+        std::unique_ptr<addrinfo, decltype(&::freeaddrinfo)> addresses(found, &::freeaddrinfo);
+        for (addrinfo* a = addresses.get(); a != nullptr; a = a->ai_next) {
+            fd = ::socket(a->ai_family, a->ai_socktype | SOCK_CLOEXEC | SOCK_NONBLOCK, a->ai_protocol);
+            if (fd < 0) {
+                continue;
+            }
+            bool connected = false;
+            try {
+                connected = connectWithin(*a, context);
+            } catch (...) {
+                ::close(fd);
+                throw;
+            }
+            if (connected) {
+                break;
+            }
+            ::close(fd);
+            fd = -1;
+        }
+        if (fd < 0) {
+            throw std::runtime_error("Cannot connect to " + hostKey);
+        }
+        int one = 1;
+        ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+
+    HttpConnection(const HttpConnection&) = delete;
+    HttpConnection& operator=(const HttpConnection&) = delete;
+
+    ~HttpConnection() {
+        if (fd >= 0) {
+            ::close(fd);
+        }
+    }
+
+    // True once any response byte has arrived; a pooled connection that fails before that was
+    // most likely closed by the server while idle.
+    bool hasReceived() const {
+        return receivedAny;
+    }
+
+    // An idle keep-alive connection has nothing to read; EOF, a reset or stray bytes mean the
+    // server has closed it (or will), so it must not carry another request.
+    bool isIdleAlive() const {
+        char probe;
+        ssize_t n;
+        do {
+            n = ::recv(fd, &probe, 1, MSG_PEEK | MSG_DONTWAIT);
+        } while (n < 0 && errno == EINTR);
+        return n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+    }
+
+    void writeAll(const std::string& data, const CallContext& context) {
+        size_t sent = 0;
+        while (sent < data.size()) {
+            ssize_t n = ::send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL | MSG_DONTWAIT);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                    await(POLLOUT, context);
+                    continue;
+                }
+                throw std::runtime_error(std::string("send failed: ") + std::strerror(errno));
+            }
+            sent += static_cast<size_t>(n);
+        }
+    }
+
+    static void appendRequest(std::string& out, const HttpRequest& request, const HttpUrl& url, bool keepAlive) {
+        out += request.method + " " + url.path + " HTTP/1.1\r\nHost: " + url.host + "\r\n";
+        if (!keepAlive) {
+            out += "Connection: close\r\n";
+        }
+        for (const auto& header : request.headers) {
+            out += header.first + ": " + header.second + "\r\n";
+        }
+        out += "Content-Length: " + std::to_string(request.body.size()) + "\r\n\r\n";
+        out += request.body;
+    }
+
+    // Read one response. Supports Content-Length and chunked bodies. Replies to HEAD and
+    // 1xx/204/304 replies carry no body, whatever their headers say.
+    HttpResponse readResponse(const CallContext& context, bool headRequest = false) {
+        HttpResponse response;
+        std::string statusLine = readLine(context);
+        if (statusLine.compare(0, 5, "HTTP/") != 0 || statusLine.size() < 12) {
+            throw std::runtime_error("Malformed status line: " + statusLine);
+        }
+        response.status = static_cast<int>(parseNumber(statusLine.substr(9, 3), 10, "status line"));
+        response.keepAlive = statusLine.compare(0, 8, "HTTP/1.0") != 0;
+
+        size_t contentLength = 0;
+        bool chunked = false;
+        for (std::string line = readLine(context); !line.empty(); line = readLine(context)) {
+            size_t colon = line.find(':');
+            if (colon == std::string::npos) {
+                continue;
+            }
+            std::string name = line.substr(0, colon);
+            for (char& c : name) {
+                c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+            }
+            size_t valueStart = line.find_first_not_of(' ', colon + 1);
+            std::string value = valueStart == std::string::npos ? std::string() : line.substr(valueStart);
+            if (name == "content-length") {
+                contentLength = parseNumber(value, 10, "Content-Length");
+            } else if (name == "transfer-encoding" && value.find("chunked") != std::string::npos) {
+                chunked = true;
+            } else if (name == "connection") {
+                response.keepAlive = value.find("close") == std::string::npos;
+            }
+        }
+
+        if (headRequest || response.status < 200 || response.status == 204 || response.status == 304) {
+            return response;
+        }
+        if (chunked) {
+            for (;;) {
+                size_t chunkSize = parseNumber(readLine(context), 16, "chunk size");
+                if (chunkSize == 0) {
+                    while (!readLine(context).empty()) {
+                    }
+                    break;
+                }
+                response.body += readExactly(chunkSize, context);
+                readLine(context);
+            }
+        } else {
+            response.body = readExactly(contentLength, context);
+        }
+        return response;
+    }
+};
+
+// Define the HttpConnectionPool class: idle keep-alive connections, kept per host.
+class HttpConnectionPool {
+private:
+    std::mutex mutex;
+    std::unordered_map<std::string, std::vector<std::unique_ptr<HttpConnection>>> idle;
+    size_t maxIdlePerHost;
+
+public:
+    explicit HttpConnectionPool(size_t maxIdlePerHost = 32) : maxIdlePerHost(maxIdlePerHost) {}
+
+    // Returns a pooled connection if a live one is idle, dropping any the server has closed;
+    // reused is set so callers can retry stale ones. fresh skips the pool and always connects.
+    std::unique_ptr<HttpConnection> acquire(const HttpUrl& url, bool& reused, const CallContext& context, bool fresh = false) {
+        while (!fresh) {
+            std::unique_ptr<HttpConnection> connection;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                auto it = idle.find(url.hostKey());
+                if (it == idle.end() || it->second.empty()) {
+                    break;
+                }
+                connection = std::move(it->second.back());
+                it->second.pop_back();
+            }
+            if (connection->isIdleAlive()) {
+                reused = true;
+                return connection;
+            }
+        }
+        reused = false;
+        return std::make_unique<HttpConnection>(url, context);
+    }
+
+    void release(std::unique_ptr<HttpConnection> connection) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto& connections = idle[connection->hostKey];
+        if (connections.size() < maxIdlePerHost) {
+            connections.push_back(std::move(connection));
+        }
+    }
+};
+
+// Define the HttpClient class: HTTP/1.1 over pooled keep-alive connections.
+class HttpClient {
+private:
+    HttpConnectionPool pool;
+    const bool reuseConnections;
+
+    // A connection abandoned mid-response (deadline, cancellation, error) is closed, never pooled.
+    std::vector<HttpResponse> exchange(const HttpUrl& url, const std::vector<HttpRequest>& requests, const CallContext& context) {
+        std::string wire;
+        bool retryable = true;
+        for (const auto& request : requests) {
+            HttpConnection::appendRequest(wire, request, url, reuseConnections);
+            retryable = retryable && request.retryable();
+        }
+        for (int attempt = 0;; ++attempt) {
+            context.check("HTTP call");
+            bool reused = false;
+            std::unique_ptr<HttpConnection> connection = pool.acquire(url, reused, context, attempt > 0);
+            std::vector<HttpResponse> responses;
+            try {
+                connection->writeAll(wire, context);
+                bool keepAlive = reuseConnections;
+                for (size_t i = 0; i < requests.size(); ++i) {
+                    responses.push_back(connection->readResponse(context, requests[i].method == "HEAD"));
+                    keepAlive = keepAlive && responses.back().keepAlive;
+                }
+                if (keepAlive) {
+                    pool.release(std::move(connection));
+                }
+                return responses;
+            } catch (const DeadlineExceeded&) {
+                throw;
+            } catch (const CallCancelled&) {
+                throw;
+            } catch (const std::runtime_error&) {
+                // A pooled connection the server closed after the idle probe fails on the write or
+                // reads EOF before any byte arrives; resend once on a newly opened one, which
+                // cannot be stale. Any other failure may
+                // come after the server acted on the request, so it is reported, not retried.
+                if (!retryable || !reused || attempt > 0 || connection->hasReceived()) {
+                    throw;
+                }
+            }
+        }
+    }
+
+public:
+    explicit HttpClient(bool reuseConnections = true, size_t maxIdlePerHost = 32)
+        : pool(maxIdlePerHost), reuseConnections(reuseConnections) {}
+
+    HttpResponse send(const HttpRequest& request, const CallContext& context = CallContext{}) {
+        return exchange(HttpUrl::parse(request.url), {request}, context).front();
+    }
+
+    // Write all requests back-to-back on one connection and read the responses in order.
+    // All requests must target the same host.
+    std::vector<HttpResponse> sendPipelined(const std::vector<HttpRequest>& requests, const CallContext& context = CallContext{}) {
+        if (requests.empty()) {
+            return {};
+        }
+        HttpUrl url = HttpUrl::parse(requests.front().url);
+        for (const auto& request : requests) {
+            if (HttpUrl::parse(request.url).hostKey() != url.hostKey()) {
+                throw std::invalid_argument("Pipelined requests must share a host: " + request.url);
+            }
+        }
+        return exchange(url, requests, context);
+    }
+};
+
+// Define the HttpServiceAdapter class: a ServiceInterface that POSTs the request to the url.
+// The operation name travels in an X-Operation header; non-2xx replies raise std::runtime_error.
+// Idempotent operations are resent when their pooled connection turns out to be stale.
+class HttpServiceAdapter : public ServiceInterface {
+private:
+    std::shared_ptr<HttpClient> client;
+    std::string serviceName;
+    std::unordered_set<std::string> idempotentOperations;
+
+public:
+    HttpServiceAdapter(std::string serviceName, std::shared_ptr<HttpClient> client,
+                       std::unordered_set<std::string> idempotentOperations = {"read"})
+        : client(std::move(client)), serviceName(std::move(serviceName)), idempotentOperations(std::move(idempotentOperations)) {}
+
+    std::string execute(const std::string& operationName, const std::string& request, const std::string& url) override {
+        return execute(operationName, request, url, CallContext{});
+    }
+
+    std::string execute(const std::string& operationName, const std::string& request, const std::string& url, const CallContext& context) override {
+        HttpRequest httpRequest;
+        httpRequest.url = url;
+        httpRequest.body = request;
+        httpRequest.retryIfStale = idempotentOperations.count(operationName) > 0;
+        httpRequest.headers.emplace_back("X-Service", serviceName);
+        httpRequest.headers.emplace_back("X-Operation", operationName);
+        httpRequest.headers.emplace_back("Content-Type", "application/json");
+        HttpResponse response = client->send(httpRequest, context);
+        if (response.status < 200 || response.status >= 300) {
+            throw std::runtime_error(serviceName + " " + operationName + " failed with HTTP " + std::to_string(response.status) + ": " + response.body);
+        }
+        return response.body;
+    }
+};
+
+#endif // HTTP_TRANSPORT_H
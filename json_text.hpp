@@ -0,0 +1,420 @@
+#ifndef JSON_TEXT_H
+#define JSON_TEXT_H
+
+#include "expected.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#endif
+
+// UTF-8 validation and JSON string (un)escaping for the ingest and output paths.
+// JsonPack hands out string values as raw bytes, escapes and all. Almost every value is plain
+// ASCII with no backslash, so each routine first skips 16 bytes at a time with SSE2 (a byte
+// loop elsewhere) and runs the scalar decoder only from the first byte that needs it: a
+// backslash or control character inside a string value, a byte >= 0x80 or, when escaping
+// output, a quote. Text with multibyte characters is validated 16 bytes at a time as well
+// when SSSE3 is available (-mssse3 or -march=native); otherwise character by character.
+
+// Function to return the offset of the first byte that is not 7-bit ASCII (and, with
+// stringValue, not a backslash or control character either), starting from `from`; length if
+// there is none.
+inline size_t skipPlainAscii(const char* data, size_t length, size_t from, bool stringValue) {
+    size_t i = from;
+#if defined(__SSE2__)
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i lastControl = _mm_set1_epi8(0x1F);
+    for (; i + 16 <= length; i += 16) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        int mask = _mm_movemask_epi8(block);
+        if (stringValue) {
+            mask |= _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(block, backslash),
+                                                   _mm_cmpeq_epi8(_mm_max_epu8(block, lastControl), lastControl)));
+        }
+        if (mask != 0) {
+            return i + static_cast<size_t>(__builtin_ctz(static_cast<unsigned>(mask)));
+        }
+    }
+#endif
+    for (; i < length; ++i) {
+        unsigned char c = static_cast<unsigned char>(data[i]);
+        if (c >= 0x80 || (stringValue && (c == '\\' || c < 0x20))) {
+            return i;
+        }
+    }
+    return length;
+}
+
+// Function to measure the UTF-8 sequence starting at data[0]: its length, or 0 if it is
+// malformed, overlong, a surrogate, beyond U+10FFFF or cut off (Unicode Table 3-7).
+inline size_t utf8SequenceLength(const char* data, size_t available) {
+    auto byte = [data](size_t i) { return static_cast<unsigned char>(data[i]); };
+    auto continuation = [&](size_t i) { return (byte(i) & 0xC0) == 0x80; };
+    unsigned char lead = byte(0);
+    if (lead < 0x80) {
+        return 1;
+    }
+    if (lead < 0xC2) {
+        return 0;
+    }
+    if (lead < 0xE0) {
+        return available >= 2 && continuation(1) ? 2 : 0;
+    }
+    if (lead < 0xF0) {
+        if (available < 3) {
+            return 0;
+        }
+        unsigned char low = lead == 0xE0 ? 0xA0 : 0x80;
+        unsigned char high = lead == 0xED ? 0x9F : 0xBF;
+        return byte(1) >= low && byte(1) <= high && continuation(2) ? 3 : 0;
+    }
+    if (lead < 0xF5) {
+        if (available < 4) {
+            return 0;
+        }
+        unsigned char low = lead == 0xF0 ? 0x90 : 0x80;
+        unsigned char high = lead == 0xF4 ? 0x8F : 0xBF;
+        return byte(1) >= low && byte(1) <= high && continuation(2) && continuation(3) ? 4 : 0;
+    }
+    return 0;
+}
+
+// Function to find the first backslash or control character from `from`; length if there is
+// none. Bytes >= 0x80 are passed over, for text already known to be valid UTF-8.
+inline size_t skipToEscape(const char* data, size_t length, size_t from) {
+    size_t i = from;
+#if defined(__SSE2__)
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i lastControl = _mm_set1_epi8(0x1F);
+    for (; i + 16 <= length; i += 16) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(block, backslash),
+                                                  _mm_cmpeq_epi8(_mm_max_epu8(block, lastControl), lastControl)));
+        if (mask != 0) {
+            return i + static_cast<size_t>(__builtin_ctz(static_cast<unsigned>(mask)));
+        }
+    }
+#endif
+    for (; i < length; ++i) {
+        unsigned char c = static_cast<unsigned char>(data[i]);
+        if (c == '\\' || c < 0x20) {
+            return i;
+        }
+    }
+    return length;
+}
+
+#if defined(__SSSE3__)
+// Function to check UTF-8 16 bytes at a time with the lookup-table method of Keiser and Lemire
+// ("Validating UTF-8 in less than one instruction per byte", 2021). Each byte is classified
+// by three 16-entry tables: the high and low nibble of the byte before it and its own high
+// nibble. ANDing the three gives the errors its two-byte window shows (too short, too long,
+// overlong, surrogate, above U+10FFFF); the third and fourth bytes of 3- and 4-byte sequences
+// are checked against the lead two and three bytes back. Returns length if the text is valid,
+// otherwise a position at or before the first invalid sequence, from which the scalar check
+// finds its exact offset.
+inline size_t utf8BlockCheck(const char* data, size_t length) {
+    constexpr char kTooShort = 1 << 0;   // lead byte not followed by a continuation
+    constexpr char kTooLong = 1 << 1;    // continuation after ASCII
+    constexpr char kOverlong3 = 1 << 2;
+    constexpr char kTooLarge = 1 << 3;
+    constexpr char kSurrogate = 1 << 4;
+    constexpr char kOverlong2 = 1 << 5;
+    constexpr char kTooLarge1000 = 1 << 6;
+    constexpr char kOverlong4 = 1 << 6;
+    constexpr char kTwoConts = static_cast<char>(1 << 7);  // continuation after continuation; fine only in 3-4 byte sequences
+    constexpr char kCarry = kTooShort | kTooLong | kTwoConts;
+
+    const __m128i byte1High = _mm_setr_epi8(
+        kTooLong, kTooLong, kTooLong, kTooLong, kTooLong, kTooLong, kTooLong, kTooLong,
+        kTwoConts, kTwoConts, kTwoConts, kTwoConts,
+        kTooShort | kOverlong2, kTooShort, kTooShort | kOverlong3 | kSurrogate,
+        kTooShort | kTooLarge | kTooLarge1000 | kOverlong4);
+    const __m128i byte1Low = _mm_setr_epi8(
+        kCarry | kOverlong3 | kOverlong2 | kOverlong4, kCarry | kOverlong2, kCarry, kCarry,
+        kCarry | kTooLarge, kCarry | kTooLarge | kTooLarge1000, kCarry | kTooLarge | kTooLarge1000, kCarry | kTooLarge | kTooLarge1000,
+        kCarry | kTooLarge | kTooLarge1000, kCarry | kTooLarge | kTooLarge1000, kCarry | kTooLarge | kTooLarge1000, kCarry | kTooLarge | kTooLarge1000,
+        kCarry | kTooLarge | kTooLarge1000, kCarry | kTooLarge | kTooLarge1000 | kSurrogate, kCarry | kTooLarge | kTooLarge1000,
+        kCarry | kTooLarge | kTooLarge1000);
+    const __m128i byte2High = _mm_setr_epi8(
+        kTooShort, kTooShort, kTooShort, kTooShort, kTooShort, kTooShort, kTooShort, kTooShort,
+        kTooLong | kOverlong2 | kTwoConts | kOverlong3 | kTooLarge1000 | kOverlong4,
+        kTooLong | kOverlong2 | kTwoConts | kOverlong3 | kTooLarge,
+        kTooLong | kOverlong2 | kTwoConts | kSurrogate | kTooLarge,
+        kTooLong | kOverlong2 | kTwoConts | kSurrogate | kTooLarge,
+        kTooShort, kTooShort, kTooShort, kTooShort);
+    // Bytes above these in the last three positions start a sequence the block does not finish.
+    const __m128i incompleteAbove = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                                                  static_cast<char>(0xF0 - 1), static_cast<char>(0xE0 - 1), static_cast<char>(0xC0 - 1));
+    const __m128i lowNibble = _mm_set1_epi8(0x0F);
+    const __m128i zero = _mm_setzero_si128();
+
+    __m128i previous = zero;
+    __m128i incomplete = zero;
+    size_t i = 0;
+    // The input ends with a block of zeros, so a sequence cut off at the end shows as too short.
+    for (bool last = false; !last; i += 16) {
+        __m128i block;
+        if (i + 16 <= length) {
+            block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        } else {
+            char tail[16] = {};
+            std::memcpy(tail, data + i, length - i);
+            block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(tail));
+            last = true;
+        }
+        __m128i error;
+        if (_mm_movemask_epi8(block) == 0) {
+            error = incomplete;
+        } else {
+            __m128i prev1 = _mm_alignr_epi8(block, previous, 15);
+            __m128i special = _mm_and_si128(
+                _mm_and_si128(_mm_shuffle_epi8(byte1High, _mm_and_si128(_mm_srli_epi16(prev1, 4), lowNibble)),
+                              _mm_shuffle_epi8(byte1Low, _mm_and_si128(prev1, lowNibble))),
+                _mm_shuffle_epi8(byte2High, _mm_and_si128(_mm_srli_epi16(block, 4), lowNibble)));
+            __m128i thirdByte = _mm_subs_epu8(_mm_alignr_epi8(block, previous, 14), _mm_set1_epi8(static_cast<char>(0xE0 - 0x80)));
+            __m128i fourthByte = _mm_subs_epu8(_mm_alignr_epi8(block, previous, 13), _mm_set1_epi8(static_cast<char>(0xF0 - 0x80)));
+            __m128i mustContinue = _mm_and_si128(_mm_or_si128(thirdByte, fourthByte), _mm_set1_epi8(static_cast<char>(0x80)));
+            error = _mm_xor_si128(mustContinue, special);
+        }
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(error, zero)) != 0xFFFF) {
+            // The bad sequence may have started up to three bytes into the previous block.
+            return i < 3 ? 0 : i - 3;
+        }
+        incomplete = _mm_subs_epu8(block, incompleteAbove);
+        previous = block;
+    }
+    return length;
+}
+#endif
+
+// Function to find the first byte of the first invalid UTF-8 sequence; length if the text is valid.
+inline size_t invalidUtf8Offset(const char* data, size_t length) {
+    size_t i = skipPlainAscii(data, length, 0, false);
+    if (i == length) {
+        return length;
+    }
+#if defined(__SSSE3__)
+    size_t checked = utf8BlockCheck(data + i, length - i);
+    if (checked == length - i) {
+        return length;
+    }
+    // Resume the exact check at the start of the character the block check stopped in.
+    i += checked;
+    while (i > 0 && (static_cast<unsigned char>(data[i]) & 0xC0) == 0x80) {
+        --i;
+    }
+#endif
+    for (;;) {
+        // A run of multibyte characters is measured one after another; the block skip is only
+        // worth setting up again once plain ASCII follows.
+        do {
+            size_t sequence = utf8SequenceLength(data + i, length - i);
+            if (sequence == 0) {
+                return i;
+            }
+            i += sequence;
+        } while (i < length && static_cast<unsigned char>(data[i]) >= 0x80);
+        i = skipPlainAscii(data, length, i, false);
+        if (i == length) {
+            return length;
+        }
+    }
+}
+
+inline bool isValidUtf8(std::string_view text) {
+    return invalidUtf8Offset(text.data(), text.size()) == text.size();
+}
+
+inline void appendUtf8(std::string& out, uint32_t codePoint) {
+    if (codePoint < 0x80) {
+        out += static_cast<char>(codePoint);
+    } else if (codePoint < 0x800) {
+        out += static_cast<char>(0xC0 | (codePoint >> 6));
+        out += static_cast<char>(0x80 | (codePoint & 0x3F));
+    } else if (codePoint < 0x10000) {
+        out += static_cast<char>(0xE0 | (codePoint >> 12));
+        out += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (codePoint & 0x3F));
+    } else {
+        out += static_cast<char>(0xF0 | (codePoint >> 18));
+        out += static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (codePoint & 0x3F));
+    }
+}
+
+// Function to read the four hex digits of a \u escape; -1 if they are not all hex.
+inline int32_t parseHex4(const char* digits) {
+    int32_t value = 0;
+    for (int i = 0; i < 4; ++i) {
+        char c = digits[i];
+        int nibble = c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : c >= 'A' && c <= 'F' ? c - 'A' + 10 : -1;
+        if (nibble < 0) {
+            return -1;
+        }
+        value = value << 4 | nibble;
+    }
+    return value;
+}
+
+// Function to decode the raw bytes of a JSON string value (without its quotes) into UTF-8 text,
+// validating it on the way. Runs of plain bytes are copied whole; \uXXXX escapes, including
+// surrogate pairs, become UTF-8. Lone surrogates, unknown escapes, raw control characters
+// (JSON requires them escaped) and malformed UTF-8 are errors, reported with the byte offset
+// at which they start.
+inline Expected<std::string> tryDecodeJsonString(std::string_view raw) {
+    const char* data = raw.data();
+    size_t length = raw.size();
+    std::string out;
+    size_t copied = 0;  // raw[copied, i) is plain text not yet appended
+    size_t i = 0;
+    bool validated = false;  // set at the first byte >= 0x80; raw[i, validUntil) is then valid UTF-8
+    size_t validUntil = length;
+    for (;;) {
+        i = validated ? skipToEscape(data, validUntil, i) : skipPlainAscii(data, length, i, true);
+        if (i == length) {
+            break;
+        }
+        if (validated && i == validUntil) {
+            return Error(ErrorCode::InvalidUtf8, raw, i);
+        }
+        if (static_cast<unsigned char>(data[i]) < 0x20) {
+            return Error(ErrorCode::ControlCharacter, raw, i);
+        }
+        if (data[i] != '\\') {
+            // Validate the rest of the text in one pass; escapes before a bad byte are still
+            // reported first.
+            validUntil = i + invalidUtf8Offset(data + i, length - i);
+            validated = true;
+            continue;
+        }
+
+        if (out.empty()) {
+            out.reserve(length);
+        }
+        out.append(data + copied, i - copied);
+        if (i + 1 >= length) {
+            return Error(ErrorCode::InvalidEscape, raw, i);
+        }
+        size_t escapeStart = i;
+        char kind = data[i + 1];
+        i += 2;
+        switch (kind) {
+            case '"': out += '"'; break;
+            case '\\': out += '\\'; break;
+            case '/': out += '/'; break;
+            case 'b': out += '\b'; break;
+            case 'f': out += '\f'; break;
+            case 'n': out += '\n'; break;
+            case 'r': out += '\r'; break;
+            case 't': out += '\t'; break;
+            case 'u': {
+                int32_t unit = i + 4 <= length ? parseHex4(data + i) : -1;
+                if (unit < 0 || (unit >= 0xDC00 && unit <= 0xDFFF)) {
+                    return Error(ErrorCode::InvalidEscape, raw, escapeStart);
+                }
+                i += 4;
+                uint32_t codePoint = static_cast<uint32_t>(unit);
+                if (unit >= 0xD800 && unit <= 0xDBFF) {
+                    int32_t low = i + 6 <= length && data[i] == '\\' && data[i + 1] == 'u' ? parseHex4(data + i + 2) : -1;
+                    if (low < 0xDC00 || low > 0xDFFF) {
+                        return Error(ErrorCode::InvalidEscape, raw, escapeStart);
+                    }
+                    i += 6;
+                    codePoint = 0x10000 + ((static_cast<uint32_t>(unit) - 0xD800) << 10) + (static_cast<uint32_t>(low) - 0xDC00);
+                }
+                appendUtf8(out, codePoint);
+                break;
+            }
+            default:
+                return Error(ErrorCode::InvalidEscape, raw, escapeStart);
+        }
+        copied = i;
+    }
+    if (copied == 0) {
+        return std::string(raw);
+    }
+    out.append(data + copied, length - copied);
+    return out;
+}
+
+// Function to escape text as the inside of a JSON string: quotes, backslashes and control
+// characters are escaped, everything else (UTF-8 included) is passed to write(data, size) as
+// is, in whole runs.
+template <typename Write>
+void escapeJson(std::string_view text, Write&& write) {
+    const char* data = text.data();
+    size_t length = text.size();
+    size_t written = 0;
+    size_t i = 0;
+    while (i < length) {
+#if defined(__SSE2__)
+        const __m128i quote = _mm_set1_epi8('"');
+        const __m128i backslash = _mm_set1_epi8('\\');
+        const __m128i lastControl = _mm_set1_epi8(0x1F);
+        bool found = false;
+        for (; i + 16 <= length; i += 16) {
+            __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+            __m128i special = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(block, quote), _mm_cmpeq_epi8(block, backslash)),
+                                           _mm_cmpeq_epi8(_mm_max_epu8(block, lastControl), lastControl));
+            int mask = _mm_movemask_epi8(special);
+            if (mask != 0) {
+                i += static_cast<size_t>(__builtin_ctz(static_cast<unsigned>(mask)));
+                found = true;
+                break;
+            }
+        }
+        if (!found)
+#endif
+        {
+            while (i < length) {
+                unsigned char c = static_cast<unsigned char>(data[i]);
+                if (c == '"' || c == '\\' || c < 0x20) {
+                    break;
+                }
+                ++i;
+            }
+            if (i == length) {
+                break;
+            }
+        }
+        write(data + written, i - written);
+        unsigned char c = static_cast<unsigned char>(data[i]);
+        switch (c) {
+            case '"': write("\\\"", 2); break;
+            case '\\': write("\\\\", 2); break;
+            case '\n': write("\\n", 2); break;
+            case '\r': write("\\r", 2); break;
+            case '\t': write("\\t", 2); break;
+            case '\b': write("\\b", 2); break;
+            case '\f': write("\\f", 2); break;
+            default: {
+                static const char hex[] = "0123456789abcdef";
+                char escaped[] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xF]};
+                write(escaped, sizeof(escaped));
+            }
+        }
+        written = ++i;
+    }
+    write(data + written, length - written);
+}
+
+inline void writeEscapedJson(std::ostream& out, std::string_view text) {
+    escapeJson(text, [&out](const char* data, size_t size) { out.write(data, static_cast<std::streamsize>(size)); });
+}
+
+inline void writeEscapedJson(std::string& out, std::string_view text) {
+    escapeJson(text, [&out](const char* data, size_t size) { out.append(data, size); });
+}
+
+#endif // JSON_TEXT_H
@@ -0,0 +1,400 @@
+#include "concurrency_limiter.hpp"
+#include "http_transport.hpp"
+#include "mock_http_server.hpp"
+#include "operation_factory.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Load generator for the dispatch path: drives OperationFactory::dispatch with a weighted mix of
+// services and operations against the in-process stub services or the loopback mock server.
+//
+//   closed loop: each thread sends its next request as soon as the previous one returns.
+//   open loop:   requests are due at a fixed total rate, whatever the responses are doing.
+//
+// Latency is measured from when a request was due, not when it was sent, so a stall counts
+// against every request it held back (coordinated-omission correction). In closed loop with
+// --rate, each thread paces itself to rate/threads and a slow call is back-filled with the
+// samples the schedule would have produced; without --rate, closed loop has no schedule and
+// reports raw service time only.
+//
+// Usage: loadgen [--mode open|closed] [--rate N] [--threads N] [--seconds S]
+//                [--mix SERVICE:OP:WEIGHT,...] [--payload MIN[-MAX]]
+//                [--target stub|mock] [--mock-latency-us N] [--mock-capacity N]
+//                [--limit] [--queue-wait-us N]
+//
+// --mock-capacity gives the mock that many workers, each taking --mock-latency-us per request,
+// so it saturates like a real counterparty. --limit puts every service in the mix behind an
+// AdaptiveLimiter; calls it sheds are counted separately and left out of the latency figures.
+
+// Define the LatencyHistogram class: log-linear buckets over nanoseconds, ~0.8% resolution.
+// Values below 256 get exact buckets; above that every power of two is split into 128.
+class LatencyHistogram {
+private:
+    static constexpr int kSubBucketBits = 8;
+    static constexpr uint64_t kSubBucketCount = 1ULL << kSubBucketBits;
+    static constexpr uint64_t kHalfCount = kSubBucketCount / 2;
+
+    std::vector<uint64_t> counts;
+    uint64_t total = 0;
+    uint64_t maxValue = 0;
+
+    static size_t indexFor(uint64_t value) {
+        if (value < kSubBucketCount) {
+            return static_cast<size_t>(value);
+        }
+        int shift = 63 - __builtin_clzll(value) - (kSubBucketBits - 1);  // value >= kSubBucketCount, so never 0
+        return static_cast<size_t>(kSubBucketCount + (shift - 1) * kHalfCount + ((value >> shift) - kHalfCount));
+    }
+
+    static uint64_t valueFor(size_t index) {
+        if (index < kSubBucketCount) {
+            return index;
+        }
+        uint64_t shift = (index - kSubBucketCount) / kHalfCount + 1;
+        uint64_t sub = (index - kSubBucketCount) % kHalfCount + kHalfCount;
+        return (sub << shift) + (1ULL << (shift - 1));  // bucket midpoint
+    }
+
+public:
+    LatencyHistogram() : counts(indexFor(~0ULL) + 1, 0) {}
+
+    void record(uint64_t nanos) {
+        ++counts[indexFor(nanos)];
+        ++total;
+        maxValue = std::max(maxValue, nanos);
+    }
+
+    // Record a sample from a paced caller; if it overran the interval, also record the samples
+    // of the requests that would have been sent in the meantime.
+    void recordCorrected(uint64_t nanos, uint64_t expectedInterval) {
+        record(nanos);
+        if (expectedInterval == 0) {
+            return;
+        }
+        for (uint64_t missing = nanos > expectedInterval ? nanos - expectedInterval : 0; missing >= expectedInterval; missing -= expectedInterval) {
+            record(missing);
+        }
+    }
+
+    void merge(const LatencyHistogram& other) {
+        for (size_t i = 0; i < counts.size(); ++i) {
+            counts[i] += other.counts[i];
+        }
+        total += other.total;
+        maxValue = std::max(maxValue, other.maxValue);
+    }
+
+    uint64_t count() const {
+        return total;
+    }
+
+    uint64_t max() const {
+        return maxValue;
+    }
+
+    uint64_t percentile(double p) const {
+        if (total == 0) {
+            return 0;
+        }
+        uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(p / 100.0 * total + 0.5));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < counts.size(); ++i) {
+            seen += counts[i];
+            if (seen >= rank) {
+                return std::min(valueFor(i), maxValue);
+            }
+        }
+        return maxValue;
+    }
+};
+
+struct MixEntry {
+    std::string serviceName;
+    std::string operationName;
+    uint32_t weight;
+};
+
+struct LoadConfig {
+    bool openLoop = false;
+    double rate = 0;  // requests per second across all threads; 0 = unpaced (closed loop only)
+    int threads = 4;
+    double seconds = 5;
+    std::vector<MixEntry> mix{{"OEPY", "create", 1}, {"OEPY", "read", 1}, {"XYZ", "create", 1}, {"XYZ", "read", 1}};
+    size_t payloadMin = 64;
+    size_t payloadMax = 64;
+    bool mockTarget = false;
+    int mockLatencyMicros = 0;
+    size_t mockCapacity = 0;  // 0 = one worker per connection
+    bool limit = false;
+    int queueWaitMicros = 0;
+};
+
+struct ThreadResult {
+    LatencyHistogram latency;
+    LatencyHistogram serviceTime;  // send to response, with no schedule correction
+    uint64_t errors = 0;
+    uint64_t shed = 0;
+};
+
+static std::vector<MixEntry> parseMix(const std::string& text) {
+    std::vector<MixEntry> mix;
+    std::stringstream items(text);
+    std::string item;
+    while (std::getline(items, item, ',')) {
+        size_t first = item.find(':');
+        size_t second = item.find(':', first == std::string::npos ? first : first + 1);
+        if (first == std::string::npos) {
+            throw std::invalid_argument("Invalid mix entry: " + item);
+        }
+        MixEntry entry;
+        entry.serviceName = item.substr(0, first);
+        entry.operationName = item.substr(first + 1, second == std::string::npos ? std::string::npos : second - first - 1);
+        entry.weight = second == std::string::npos ? 1 : static_cast<uint32_t>(std::stoul(item.substr(second + 1)));
+        mix.push_back(entry);
+    }
+    if (mix.empty()) {
+        throw std::invalid_argument("Empty mix");
+    }
+    return mix;
+}
+
+static LoadConfig parseArguments(int argc, char** argv) {
+    LoadConfig config;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto next = [&]() -> std::string {
+            if (i + 1 >= argc) {
+                throw std::invalid_argument("Missing value for " + arg);
+            }
+            return argv[++i];
+        };
+        if (arg == "--mode") {
+            std::string mode = next();
+            if (mode != "open" && mode != "closed") {
+                throw std::invalid_argument("Unknown mode: " + mode);
+            }
+            config.openLoop = mode == "open";
+        } else if (arg == "--rate") {
+            config.rate = std::stod(next());
+        } else if (arg == "--threads") {
+            config.threads = std::max(1, std::stoi(next()));
+        } else if (arg == "--seconds") {
+            config.seconds = std::stod(next());
+        } else if (arg == "--mix") {
+            config.mix = parseMix(next());
+        } else if (arg == "--payload") {
+            std::string range = next();
+            size_t dash = range.find('-');
+            config.payloadMin = std::stoul(range.substr(0, dash));
+            config.payloadMax = dash == std::string::npos ? config.payloadMin : std::stoul(range.substr(dash + 1));
+            if (config.payloadMax < config.payloadMin) {
+                throw std::invalid_argument("Invalid payload range: " + range);
+            }
+        } else if (arg == "--target") {
+            std::string target = next();
+            if (target != "stub" && target != "mock") {
+                throw std::invalid_argument("Unknown target: " + target);
+            }
+            config.mockTarget = target == "mock";
+        } else if (arg == "--mock-latency-us") {
+            config.mockLatencyMicros = std::stoi(next());
+        } else if (arg == "--mock-capacity") {
+            config.mockCapacity = std::stoul(next());
+        } else if (arg == "--limit") {
+            config.limit = true;
+        } else if (arg == "--queue-wait-us") {
+            config.queueWaitMicros = std::stoi(next());
+        } else {
+            throw std::invalid_argument("Unknown argument: " + arg);
+        }
+    }
+    if (config.openLoop && config.rate <= 0) {
+        throw std::invalid_argument("Open loop needs --rate");
+    }
+    return config;
+}
+
+static void runThread(const LoadConfig& config, const std::shared_ptr<AdapterRegistry>& registry, const std::string& baseUrl,
+                      std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point stop, int threadIndex, ThreadResult& result) {
+    using Clock = std::chrono::steady_clock;
+    OperationFactory factory(registry);
+
+    uint64_t state = 0x9e3779b97f4a7c15ULL * static_cast<uint64_t>(threadIndex + 1);
+    auto random = [&state]() {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return state;
+    };
+
+    std::vector<std::string> payloads(64);
+    for (std::string& payload : payloads) {
+        size_t span = config.payloadMax - config.payloadMin + 1;
+        payload.assign(config.payloadMin + random() % span, 'x');
+        for (char& c : payload) {
+            c = static_cast<char>('a' + random() % 26);
+        }
+    }
+    std::vector<std::string> urls;
+    uint32_t totalWeight = 0;
+    for (const MixEntry& entry : config.mix) {
+        urls.push_back(baseUrl + "/" + entry.serviceName + "/api/" + entry.operationName);
+        totalWeight += entry.weight;
+    }
+
+    double perThreadRate = config.rate / config.threads;
+    auto interval = perThreadRate > 0 ? std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / perThreadRate)) : Clock::duration::zero();
+    // Stagger threads across one interval so their schedules do not line up.
+    Clock::time_point due = start + interval * threadIndex / config.threads;
+
+    while (true) {
+        if (interval.count() > 0) {
+            if (due >= stop) {
+                break;
+            }
+            // Sleep most of the way, then spin: sleep_until alone overshoots by tens of
+            // microseconds, which would show up as latency.
+            std::this_thread::sleep_until(due - std::chrono::microseconds(100));
+            while (Clock::now() < due) {
+                std::this_thread::yield();
+            }
+        } else {
+            due = Clock::now();
+            if (due >= stop) {
+                break;
+            }
+        }
+
+        uint32_t pick = static_cast<uint32_t>(random() % totalWeight);
+        size_t entry = 0;
+        while (pick >= config.mix[entry].weight) {
+            pick -= config.mix[entry++].weight;
+        }
+        const std::string& payload = payloads[random() % payloads.size()];
+
+        Clock::time_point sent = Clock::now();
+        try {
+            factory.dispatch(config.mix[entry].serviceName, config.mix[entry].operationName, urls[entry], payload);
+        } catch (const ServiceOverloaded&) {
+            ++result.shed;
+            due += interval;
+            continue;
+        } catch (const std::exception&) {
+            ++result.errors;
+        }
+        Clock::time_point done = Clock::now();
+
+        uint64_t serviceNanos = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(done - sent).count());
+        result.serviceTime.record(serviceNanos);
+        if (config.openLoop) {
+            result.latency.record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(done - due).count()));
+        } else {
+            result.latency.recordCorrected(serviceNanos, static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(interval).count()));
+        }
+        due += interval;
+    }
+}
+
+static void printLatency(const std::string& label, const LatencyHistogram& histogram) {
+    auto micros = [](uint64_t nanos) { return nanos / 1000.0; };
+    std::cout << label << " (us): p50 " << micros(histogram.percentile(50)) << ", p90 " << micros(histogram.percentile(90)) << ", p99 "
+              << micros(histogram.percentile(99)) << ", p99.9 " << micros(histogram.percentile(99.9)) << ", p99.99 "
+              << micros(histogram.percentile(99.99)) << ", max " << micros(histogram.max()) << std::endl;
+}
+
+int main(int argc, char** argv) {
+    try {
+        LoadConfig config = parseArguments(argc, argv);
+
+        auto registry = AdapterRegistry::defaults();
+        std::unique_ptr<MockHttpServer> server;
+        std::string baseUrl = "http://stub";
+        if (config.mockTarget) {
+            MockHttpServer::Handler handler = MockHttpServer::echoHandler();
+            if (config.mockCapacity > 0) {
+                int latency = config.mockLatencyMicros;
+                handler = MockHttpServer::withCapacity(handler, config.mockCapacity, [latency] { return std::chrono::microseconds(latency); });
+            } else if (config.mockLatencyMicros > 0) {
+                int latency = config.mockLatencyMicros;
+                handler = MockHttpServer::withLatency(handler, [latency] { return std::chrono::microseconds(latency); });
+            }
+            server = std::make_unique<MockHttpServer>(handler);
+            baseUrl = server->baseUrl();
+            registry = std::make_shared<AdapterRegistry>();
+            auto client = std::make_shared<HttpClient>();
+            for (const MixEntry& entry : config.mix) {
+                std::string serviceName = entry.serviceName;
+                registry->registerFactory(serviceName, [serviceName, client] { return std::make_unique<HttpServiceAdapter>(serviceName, client); });
+            }
+        }
+
+        std::vector<std::pair<std::string, std::shared_ptr<AdaptiveLimiter>>> limiters;
+        if (config.limit) {
+            auto limited = std::make_shared<AdapterRegistry>();
+            ConcurrencyPolicy policy;
+            policy.maxQueueWait = std::chrono::microseconds(config.queueWaitMicros);
+            for (const MixEntry& entry : config.mix) {
+                if (limited->contains(entry.serviceName) || !registry->contains(entry.serviceName)) {
+                    continue;
+                }
+                limited->registerFactory(entry.serviceName, registry->factoryFor(entry.serviceName));
+                limiters.emplace_back(entry.serviceName, limitService(*limited, entry.serviceName, policy));
+            }
+            registry = limited;
+        }
+
+        std::vector<ThreadResult> results(config.threads);
+        std::vector<std::thread> threads;
+        auto start = std::chrono::steady_clock::now() + std::chrono::milliseconds(10);
+        auto stop = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(config.seconds));
+        for (int t = 0; t < config.threads; ++t) {
+            threads.emplace_back(runThread, std::cref(config), std::cref(registry), std::cref(baseUrl), start, stop, t, std::ref(results[t]));
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        ThreadResult combined;
+        for (const ThreadResult& result : results) {
+            combined.latency.merge(result.latency);
+            combined.serviceTime.merge(result.serviceTime);
+            combined.errors += result.errors;
+            combined.shed += result.shed;
+        }
+
+        std::cout << (config.openLoop ? "open" : "closed") << " loop, " << config.threads << " threads, target "
+                  << (config.mockTarget ? "mock " + baseUrl : std::string("stub")) << ", payload " << config.payloadMin << "-" << config.payloadMax
+                  << " bytes";
+        if (config.rate > 0) {
+            std::cout << ", rate " << config.rate << "/s";
+        }
+        std::cout << std::endl;
+        std::cout << std::fixed << std::setprecision(1);
+        std::cout << "requests " << combined.serviceTime.count() << ", errors " << combined.errors << ", shed " << combined.shed << ", throughput "
+                  << combined.serviceTime.count() / elapsed << " req/s" << std::endl;
+        if (config.openLoop || config.rate > 0) {
+            printLatency("latency, corrected", combined.latency);
+        }
+        printLatency("service time", combined.serviceTime);
+        if (server != nullptr) {
+            std::cout << "mock server: " << server->requests() << " requests over " << server->connections() << " connections" << std::endl;
+        }
+        for (const auto& [serviceName, limiter] : limiters) {
+            limiter->report(serviceName, std::cout);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,80 @@
+#ifndef MESSAGE_BINDING_H
+#define MESSAGE_BINDING_H
+
+#include "json_text.hpp"
+
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <variant>
+#include <vector>
+
+// Field descriptors for typed service messages: each names a field and points at the member
+// that holds it, so a compiled mapping can write extracted values straight into a message
+// instead of serializing them to JSON text for the adapter to parse again.
+
+template <typename Msg>
+struct FieldDescriptor {
+    using Member = std::variant<std::string Msg::*, double Msg::*, long long Msg::*, bool Msg::*>;
+
+    std::string_view name;
+    Member member;
+};
+
+// Specialise for each message type with
+//     static const std::vector<FieldDescriptor<Msg>>& fields();
+template <typename Msg>
+struct MessageDescriptor;
+
+template <typename Msg>
+const FieldDescriptor<Msg>* findField(std::string_view name) {
+    for (const FieldDescriptor<Msg>& field : MessageDescriptor<Msg>::fields()) {
+        if (field.name == name) {
+            return &field;
+        }
+    }
+    return nullptr;
+}
+
+// Function to render a typed message in the transformJson output layout, so it can also be
+// sent as request text to an adapter that does not take Msg directly.
+template <typename Msg>
+std::string describeMessage(const Msg& msg) {
+    std::ostringstream text;
+    text << "{";
+    bool first = true;
+    for (const FieldDescriptor<Msg>& field : MessageDescriptor<Msg>::fields()) {
+        if (!first) {
+            text << ",";
+        }
+        first = false;
+        text << "\"";
+        writeEscapedJson(text, field.name);
+        text << "\": \"";
+        std::visit([&](auto member) {
+            using Field = std::decay_t<decltype(msg.*member)>;
+            if constexpr (std::is_same_v<Field, std::string>) {
+                writeEscapedJson(text, msg.*member);
+            } else if constexpr (std::is_same_v<Field, bool>) {
+                text << (msg.*member ? "true" : "false");
+            } else {
+                text << std::to_string(msg.*member);
+            }
+        }, field.member);
+        text << "\"";
+    }
+    text << "}";
+    return text.str();
+}
+
+// Define the TypedServiceInterface class: implemented by adapters that accept Msg directly,
+// next to the string-based ServiceInterface.
+template <typename Msg>
+class TypedServiceInterface {
+public:
+    virtual ~TypedServiceInterface() = default;
+    virtual std::string executeTyped(const std::string& operationName, const Msg& message, const std::string& url) = 0;
+};
+
+#endif // MESSAGE_BINDING_H
@@ -0,0 +1,289 @@
+#ifndef MOCK_HTTP_SERVER_H
+#define MOCK_HTTP_SERVER_H
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+struct MockRequest {
+    std::string method;
+    std::string path;
+    std::string operation;  // X-Operation header
+    std::string body;
+};
+
+struct MockReply {
+    int status = 200;
+    std::string body;
+};
+
+// Define the MockHttpServer class: a tiny HTTP/1.1 server on 127.0.0.1 for tests and benchmarks.
+// Each connection gets its own thread and may carry keep-alive and pipelined requests; when it
+// ends, its socket is closed and its thread is reaped by the accept loop. The default handler
+// echoes "<operation> at <path>: <body>", mirroring the stub services.
+class MockHttpServer {
+public:
+    using Handler = std::function<MockReply(const MockRequest&)>;
+
+private:
+    int listenFd = -1;
+    int port = 0;
+    Handler handler;
+    std::atomic<bool> running{true};
+    std::thread acceptThread;
+    std::mutex connectionsMutex;
+    std::condition_variable connectionEnded;
+    std::unordered_map<int, std::thread> openConnections;  // fd -> its thread, until the fd is closed
+    std::vector<std::thread> finishedThreads;              // ended, waiting to be joined
+    std::atomic<uint64_t> connectionsAccepted{0};
+    std::atomic<uint64_t> requestsServed{0};
+
+    static MockReply echo(const MockRequest& request) {
+        return {200, request.operation + " at " + request.path + ": " + request.body};
+    }
+
+    // Parse one complete request from buffer; returns false if more bytes are needed.
+    static bool parseRequest(std::string& buffer, MockRequest& request, bool& keepAlive) {
+        size_t headerEnd = buffer.find("\r\n\r\n");
+        if (headerEnd == std::string::npos) {
+            return false;
+        }
+        size_t lineEnd = buffer.find("\r\n");
+        std::string requestLine = buffer.substr(0, lineEnd);
+        size_t space1 = requestLine.find(' ');
+        size_t space2 = requestLine.find(' ', space1 + 1);
+        request.method = requestLine.substr(0, space1);
+        request.path = requestLine.substr(space1 + 1, space2 - space1 - 1);
+        request.operation.clear();
+        keepAlive = true;
+
+        size_t contentLength = 0;
+        size_t pos = lineEnd + 2;
+        while (pos < headerEnd) {
+            size_t eol = buffer.find("\r\n", pos);
+            std::string line = buffer.substr(pos, eol - pos);
+            pos = eol + 2;
+            size_t colon = line.find(':');
+            if (colon == std::string::npos) {
+                continue;
+            }
+            std::string name = line.substr(0, colon);
+            for (char& c : name) {
+                c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+            }
+            size_t valueStart = line.find_first_not_of(' ', colon + 1);
+            std::string value = valueStart == std::string::npos ? std::string() : line.substr(valueStart);
+            if (name == "content-length") {
+                contentLength = std::stoul(value);
+            } else if (name == "x-operation") {
+                request.operation = value;
+            } else if (name == "connection" && value.find("close") != std::string::npos) {
+                keepAlive = false;
+            }
+        }
+        if (buffer.size() < headerEnd + 4 + contentLength) {
+            return false;
+        }
+        request.body = buffer.substr(headerEnd + 4, contentLength);
+        buffer.erase(0, headerEnd + 4 + contentLength);
+        return true;
+    }
+
+    static bool writeAll(int fd, const std::string& data) {
+        size_t sent = 0;
+        while (sent < data.size()) {
+            ssize_t n = ::send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                return false;
+            }
+            sent += static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+    void serveConnection(int fd) {
+        std::string buffer;
+        std::string out;
+        char chunk[16384];
+        bool keepAlive = true;
+        while (keepAlive && running.load(std::memory_order_relaxed)) {
+            ssize_t n = ::recv(fd, chunk, sizeof(chunk), 0);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                break;
+            }
+            buffer.append(chunk, static_cast<size_t>(n));
+            // Answer every complete request in the buffer, so pipelined requests share one write.
+            out.clear();
+            MockRequest request;
+            while (keepAlive && parseRequest(buffer, request, keepAlive)) {
+                MockReply reply = handler(request);
+                out += "HTTP/1.1 " + std::to_string(reply.status) + (reply.status < 400 ? " OK" : " Error") + "\r\n";
+                out += "Content-Length: " + std::to_string(reply.body.size()) + "\r\n";
+                out += keepAlive ? "Connection: keep-alive\r\n\r\n" : "Connection: close\r\n\r\n";
+                out += reply.body;
+                requestsServed.fetch_add(1, std::memory_order_relaxed);
+            }
+            if (!out.empty() && !writeAll(fd, out)) {
+                break;
+            }
+        }
+        // Close under the lock, so the destructor never shuts down an fd number reused since.
+        std::lock_guard<std::mutex> lock(connectionsMutex);
+        ::close(fd);
+        auto self = openConnections.find(fd);
+        finishedThreads.push_back(std::move(self->second));
+        openConnections.erase(self);
+        connectionEnded.notify_all();
+    }
+
+    void reapFinished() {
+        std::vector<std::thread> finished;
+        {
+            std::lock_guard<std::mutex> lock(connectionsMutex);
+            finished.swap(finishedThreads);
+        }
+        for (auto& thread : finished) {
+            thread.join();
+        }
+    }
+
+    void acceptLoop() {
+        while (running.load()) {
+            int fd = ::accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+            reapFinished();
+            if (fd < 0) {
+                if (!running.load()) {
+                    break;  // listening socket was shut down
+                }
+                if (errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM) {
+                    // Out of descriptors or memory: wait for connections to close, then retry.
+                    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                }
+                continue;
+            }
+            int one = 1;
+            ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            connectionsAccepted.fetch_add(1, std::memory_order_relaxed);
+            // Held while the thread starts, so it cannot finish before it is registered.
+            std::lock_guard<std::mutex> lock(connectionsMutex);
+            openConnections.emplace(fd, std::thread([this, fd] { serveConnection(fd); }));
+        }
+    }
+
+public:
+    explicit MockHttpServer(Handler handler = echo) : handler(std::move(handler)) {
+        listenFd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (listenFd < 0) {
+            throw std::runtime_error(std::string("socket failed: ") + std::strerror(errno));
+        }
+        int one = 1;
+        ::setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = 0;  // let the kernel pick a free port
+        socklen_t length = sizeof(address);
+        if (::bind(listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+            ::listen(listenFd, 1024) != 0 ||
+            ::getsockname(listenFd, reinterpret_cast<sockaddr*>(&address), &length) != 0) {
+            ::close(listenFd);
+            throw std::runtime_error(std::string("Cannot start mock server: ") + std::strerror(errno));
+        }
+        port = ntohs(address.sin_port);
+        acceptThread = std::thread([this] { acceptLoop(); });
+    }
+
+    MockHttpServer(const MockHttpServer&) = delete;
+    MockHttpServer& operator=(const MockHttpServer&) = delete;
+
+    ~MockHttpServer() {
+        running.store(false);
+        ::shutdown(listenFd, SHUT_RDWR);
+        acceptThread.join();
+        ::close(listenFd);
+        {
+            std::unique_lock<std::mutex> lock(connectionsMutex);
+            for (auto& connection : openConnections) {
+                ::shutdown(connection.first, SHUT_RDWR);
+            }
+            connectionEnded.wait(lock, [this] { return openConnections.empty(); });
+        }
+        reapFinished();
+    }
+
+    // Wrap a handler so each reply is delayed by latency(), e.g. to model a slow upstream tail.
+    static Handler withLatency(Handler handler, std::function<std::chrono::microseconds()> latency) {
+        return [handler = std::move(handler), latency = std::move(latency)](const MockRequest& request) {
+            std::this_thread::sleep_for(latency());
+            return handler(request);
+        };
+    }
+
+    // Wrap a handler to model a counterparty with `capacity` workers that each spend
+    // serviceTime() per request: requests beyond capacity wait for a free worker, so latency
+    // climbs with load instead of staying flat. Pair with withLatency for network delay.
+    static Handler withCapacity(Handler handler, size_t capacity, std::function<std::chrono::microseconds()> serviceTime) {
+        struct Workers {
+            std::mutex mutex;
+            std::condition_variable freed;
+            size_t busy = 0;
+        };
+        auto workers = std::make_shared<Workers>();
+        return [handler = std::move(handler), capacity, serviceTime = std::move(serviceTime), workers](const MockRequest& request) {
+            {
+                std::unique_lock<std::mutex> lock(workers->mutex);
+                workers->freed.wait(lock, [&] { return workers->busy < capacity; });
+                ++workers->busy;
+            }
+            std::this_thread::sleep_for(serviceTime());
+            MockReply reply = handler(request);
+            {
+                std::lock_guard<std::mutex> lock(workers->mutex);
+                --workers->busy;
+            }
+            workers->freed.notify_one();
+            return reply;
+        };
+    }
+
+    static Handler echoHandler() {
+        return echo;
+    }
+
+    std::string baseUrl() const {
+        return "http://127.0.0.1:" + std::to_string(port);
+    }
+
+    uint64_t connections() const {
+        return connectionsAccepted.load();
+    }
+
+    uint64_t requests() const {
+        return requestsServed.load();
+    }
+};
+
+#endif // MOCK_HTTP_SERVER_H
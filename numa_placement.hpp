@@ -0,0 +1,255 @@
+#ifndef NUMA_PLACEMENT_H
+#define NUMA_PLACEMENT_H
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// CPU and NUMA placement for worker threads, using the raw Linux interfaces
+// (sched/pthread affinity, set_mempolicy, mbind, getcpu) so no libnuma is needed.
+// With the policy Off, or on a machine with one node, every call here is a no-op.
+
+// Values from <linux/mempolicy.h>.
+constexpr int kMpolPreferred = 1;
+constexpr int kMpolBind = 2;
+constexpr unsigned kMpolMfMove = 1u << 1;
+
+struct PlacementPolicy {
+    enum class Mode {
+        Off,      // leave threads where the scheduler puts them
+        Compact,  // fill the CPUs of one node before moving to the next
+        Spread,   // alternate workers across nodes
+    };
+    Mode mode = Mode::Off;
+    bool localMemory = true;  // make each placed thread allocate from its own node
+
+    bool enabled() const {
+        return mode != Mode::Off;
+    }
+};
+
+struct Placement {
+    int node = -1;  // -1 when not placed
+    int cpu = -1;
+};
+
+// Define the NumaTopology class: the nodes and their CPUs usable by this process.
+class NumaTopology {
+private:
+    std::vector<std::vector<int>> nodeCpus;
+    std::vector<int> cpuNode;
+
+    static std::vector<int> parseCpuList(const std::string& list) {
+        std::vector<int> cpus;
+        std::stringstream ranges(list);
+        std::string range;
+        while (std::getline(ranges, range, ',')) {
+            if (range.find_first_not_of(" \n") == std::string::npos) {
+                continue;
+            }
+            size_t dash = range.find('-');
+            int first = std::stoi(range.substr(0, dash));
+            int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+            for (int cpu = first; cpu <= last; ++cpu) {
+                cpus.push_back(cpu);
+            }
+        }
+        return cpus;
+    }
+
+public:
+    NumaTopology() {
+        cpu_set_t allowed;
+        CPU_ZERO(&allowed);
+        bool haveMask = ::sched_getaffinity(0, sizeof(allowed), &allowed) == 0;
+        auto usable = [&](int cpu) { return !haveMask || (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed)); };
+
+        for (int node = 0;; ++node) {
+            std::ifstream file("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+            if (!file) {
+                if (node > 0 || !nodeCpus.empty()) {
+                    break;
+                }
+                // No sysfs node information: treat the machine as a single node.
+                std::vector<int> cpus;
+                for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+                    if (haveMask && CPU_ISSET(cpu, &allowed)) {
+                        cpus.push_back(cpu);
+                    }
+                }
+                nodeCpus.push_back(std::move(cpus));
+                break;
+            }
+            std::string list;
+            std::getline(file, list);
+            std::vector<int> cpus;
+            for (int cpu : parseCpuList(list)) {
+                if (usable(cpu)) {
+                    cpus.push_back(cpu);
+                }
+            }
+            nodeCpus.push_back(std::move(cpus));
+        }
+        // Memory-only nodes, or nodes outside our cpuset, cannot run workers.
+        for (size_t node = 0; node < nodeCpus.size(); ++node) {
+            for (int cpu : nodeCpus[node]) {
+                if (cpu >= static_cast<int>(cpuNode.size())) {
+                    cpuNode.resize(cpu + 1, -1);
+                }
+                cpuNode[cpu] = static_cast<int>(node);
+            }
+        }
+    }
+
+    static const NumaTopology& system() {
+        static const NumaTopology topology;
+        return topology;
+    }
+
+    size_t nodeCount() const {
+        return nodeCpus.size();
+    }
+
+    const std::vector<int>& cpus(size_t node) const {
+        return nodeCpus.at(node);
+    }
+
+    int nodeOf(int cpu) const {
+        return cpu >= 0 && cpu < static_cast<int>(cpuNode.size()) ? cpuNode[cpu] : -1;
+    }
+
+    // Nodes that have at least one usable CPU.
+    std::vector<int> computeNodes() const {
+        std::vector<int> nodes;
+        for (size_t node = 0; node < nodeCpus.size(); ++node) {
+            if (!nodeCpus[node].empty()) {
+                nodes.push_back(static_cast<int>(node));
+            }
+        }
+        return nodes;
+    }
+};
+
+// Function to choose where worker `index` runs under policy. Workers beyond the CPU count wrap.
+inline Placement placementFor(const PlacementPolicy& policy, size_t index, const NumaTopology& topology = NumaTopology::system()) {
+    if (!policy.enabled()) {
+        return {};
+    }
+    std::vector<int> nodes = topology.computeNodes();
+    if (nodes.empty()) {
+        return {};
+    }
+    if (policy.mode == PlacementPolicy::Mode::Spread) {
+        int node = nodes[index % nodes.size()];
+        const std::vector<int>& cpus = topology.cpus(node);
+        return {node, cpus[(index / nodes.size()) % cpus.size()]};
+    }
+    size_t total = 0;
+    for (int node : nodes) {
+        total += topology.cpus(node).size();
+    }
+    size_t slot = index % total;
+    for (int node : nodes) {
+        const std::vector<int>& cpus = topology.cpus(node);
+        if (slot < cpus.size()) {
+            return {node, cpus[slot]};
+        }
+        slot -= cpus.size();
+    }
+    return {};
+}
+
+// Function to pin the calling thread and, if asked, make its allocations prefer its node.
+// Placement is advisory: returns false if the kernel refused, and the thread carries on unpinned.
+inline bool applyPlacement(const Placement& placement, bool localMemory = true) {
+    if (placement.cpu < 0) {
+        return true;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(placement.cpu, &set);
+    bool ok = ::pthread_setaffinity_np(::pthread_self(), sizeof(set), &set) == 0;
+    if (localMemory && placement.node >= 0 && placement.node < 64) {
+        unsigned long mask = 1UL << placement.node;
+        ok = ::syscall(SYS_set_mempolicy, kMpolPreferred, &mask, sizeof(mask) * 8 + 1) == 0 && ok;
+    }
+    return ok;
+}
+
+// Function to move (or pre-place) the pages of an existing buffer onto a node, e.g. a queue
+// allocated by the thread that built it but read by a worker on another socket. Only whole
+// pages inside [data, data + length) are bound.
+inline bool bindToNode(const void* data, size_t length, int node) {
+    if (node < 0 || node >= 64 || data == nullptr) {
+        return true;
+    }
+    uintptr_t page = static_cast<uintptr_t>(::sysconf(_SC_PAGESIZE));
+    uintptr_t begin = (reinterpret_cast<uintptr_t>(data) + page - 1) & ~(page - 1);
+    uintptr_t end = (reinterpret_cast<uintptr_t>(data) + length) & ~(page - 1);
+    if (end <= begin) {
+        return true;
+    }
+    unsigned long mask = 1UL << node;
+    return ::syscall(SYS_mbind, begin, end - begin, kMpolBind, &mask, sizeof(mask) * 8 + 1, kMpolMfMove) == 0;
+}
+
+// Function to return the node the calling thread is running on, or -1 if unknown.
+inline int currentNode() {
+    unsigned cpu = 0;
+    unsigned node = 0;
+    if (::syscall(SYS_getcpu, &cpu, &node, nullptr) != 0) {
+        return -1;
+    }
+    return static_cast<int>(node);
+}
+
+// Define the NodeCounters class: work done per NUMA node, for throughput reports.
+// Each node's count sits on its own cache line. Hot paths should still batch their adds (or
+// keep their own counts and fill a NodeCounters only to report), since every add on a node
+// touches the same line.
+class NodeCounters {
+private:
+    struct alignas(64) Count {
+        std::atomic<uint64_t> value{0};
+    };
+
+    std::unique_ptr<Count[]> counts;
+    size_t nodes;
+
+public:
+    explicit NodeCounters(size_t nodeCount = NumaTopology::system().nodeCount())
+        : counts(new Count[std::max<size_t>(1, nodeCount)]), nodes(std::max<size_t>(1, nodeCount)) {}
+
+    void add(int node, uint64_t amount = 1) {
+        counts[node >= 0 && static_cast<size_t>(node) < nodes ? node : 0].value.fetch_add(amount, std::memory_order_relaxed);
+    }
+
+    uint64_t count(size_t node) const {
+        return counts[node].value.load(std::memory_order_relaxed);
+    }
+
+    size_t nodeCount() const {
+        return nodes;
+    }
+
+    void report(const std::string& label, double elapsedSeconds, std::ostream& out) const {
+        for (size_t node = 0; node < nodes; ++node) {
+            uint64_t done = count(node);
+            out << label << " node " << node << ": " << done << " records, "
+                << static_cast<uint64_t>(elapsedSeconds > 0 ? done / elapsedSeconds : 0) << " rec/s\n";
+        }
+    }
+};
+
+#endif // NUMA_PLACEMENT_H
@@ -0,0 +1,548 @@
+#ifndef OPERATION_FACTORY_H
+#define OPERATION_FACTORY_H
+
+#include "expected.hpp"
+#include "json_text.hpp"
+#include "message_binding.hpp"
+#include "trace.hpp"
+#include "worker_pool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+using Deadline = std::chrono::steady_clock::time_point;
+
+class DeadlineExceeded : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
+class CallCancelled : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
+// Define the CallContext struct: the deadline and cancellation flag that travel with one call.
+struct CallContext {
+    Deadline deadline = Deadline::max();
+    const std::atomic<bool>* cancelled = nullptr;
+
+    static CallContext withTimeout(std::chrono::steady_clock::duration timeout) {
+        return {std::chrono::steady_clock::now() + timeout, nullptr};
+    }
+
+    bool hasDeadline() const {
+        return deadline != Deadline::max();
+    }
+
+    std::chrono::steady_clock::duration remaining() const {
+        return deadline - std::chrono::steady_clock::now();
+    }
+
+    bool isCancelled() const {
+        return cancelled != nullptr && cancelled->load(std::memory_order_relaxed);
+    }
+
+    bool isExpired() const {
+        return hasDeadline() && std::chrono::steady_clock::now() >= deadline;
+    }
+
+    void check(const std::string& what) const {
+        if (isCancelled()) {
+            throw CallCancelled(what + " cancelled");
+        }
+        if (isExpired()) {
+            throw DeadlineExceeded(what + " exceeded its deadline");
+        }
+    }
+};
+
+// Define the ServiceInterface class.
+class ServiceInterface {
+public:
+    virtual ~ServiceInterface() = default;
+    virtual std::string execute(const std::string& operationName, const std::string& request, const std::string& url) = 0;
+
+    // Adapters that block (e.g. on the network) override this to honour the deadline while
+    // waiting; in-process adapters only check it before running.
+    virtual std::string execute(const std::string& operationName, const std::string& request, const std::string& url, const CallContext& context) {
+        context.check(operationName);
+        return execute(operationName, request, url);
+    }
+
+    // Non-throwing variant for paths where failures are routine. Adapters that can detect an
+    // unsupported operation without unwinding override it; the default falls back to a catch.
+    virtual Expected<std::string> tryExecute(const std::string& operationName, const std::string& request, const std::string& url, const CallContext& context) {
+        try {
+            return execute(operationName, request, url, context);
+        } catch (const std::exception& e) {
+            return Error(ErrorCode::ServiceFailed, e.what());
+        }
+    }
+};
+
+// Define the OeService class and its related structs.
+// A message converted from a request string views it (valid for the duration of the call) and
+// leaves the typed fields empty; one bound by a MessageBinding fills the typed fields instead.
+struct OeMsg {
+    std::string_view data;
+    std::string reference;
+    std::string type;
+    double amount = 0;
+    bool active = false;
+};
+
+template <>
+struct MessageDescriptor<OeMsg> {
+    static const std::vector<FieldDescriptor<OeMsg>>& fields() {
+        static const std::vector<FieldDescriptor<OeMsg>> descriptors = {
+            {"reference", &OeMsg::reference},
+            {"type", &OeMsg::type},
+            {"amount", &OeMsg::amount},
+            {"active", &OeMsg::active},
+        };
+        return descriptors;
+    }
+};
+
+inline std::string describe(const OeMsg& oeMsg) {
+    return oeMsg.data.empty() ? describeMessage(oeMsg) : std::string(oeMsg.data);
+}
+
+class OeService {
+public:
+    std::string create(const std::string& url, const OeMsg& oeMsg) {
+        return "OEPY created at " + url + ": " + describe(oeMsg);
+    }
+
+    std::string read(const std::string& url, const OeMsg& oeMsg) {
+        return "OEPY read at " + url + ": " + describe(oeMsg);
+    }
+
+    std::string newFunction(const std::string& url, const OeMsg& oeMsg) {
+        return "OEPY new function at " + url + ": " + describe(oeMsg);
+    }
+};
+
+// Define the OeAdapter class.
+class OeAdapter : public ServiceInterface, public TypedServiceInterface<OeMsg> {
+private:
+    OeService oeService;
+    std::unordered_map<std::string, std::function<std::string(const std::string&, const OeMsg&)>> functionMap;
+
+    OeMsg convertToOeMsg(std::string_view request) {
+        OeMsg oeMsg;
+        oeMsg.data = request;
+        return oeMsg;
+    }
+
+public:
+    OeAdapter() {
+        functionMap["create"] = [this](const std::string& url, const OeMsg& oeMsg) {
+            return this->oeService.create(url, oeMsg);
+        };
+        functionMap["read"] = [this](const std::string& url, const OeMsg& oeMsg) {
+            return this->oeService.read(url, oeMsg);
+        };
+        functionMap["newFunction"] = [this](const std::string& url, const OeMsg& oeMsg) {
+            return this->oeService.newFunction(url, oeMsg);
+        };
+    }
+
+    // The lambdas capture this, so an adapter must never be copied or moved.
+    OeAdapter(const OeAdapter&) = delete;
+    OeAdapter& operator=(const OeAdapter&) = delete;
+
+    using ServiceInterface::execute;
+
+    std::string execute(const std::string& operationName, const std::string& request, const std::string& url) override {
+        OeMsg oeMsg = convertToOeMsg(request);
+        auto it = functionMap.find(operationName);
+        if (it != functionMap.end()) {
+            return it->second(url, oeMsg);
+        } else {
+            throw std::invalid_argument("Unsupported operation: " + operationName);
+        }
+    }
+
+    // Run an operation on a message that was bound field by field; no request text involved.
+    std::string executeTyped(const std::string& operationName, const OeMsg& oeMsg, const std::string& url) override {
+        auto it = functionMap.find(operationName);
+        if (it != functionMap.end()) {
+            return it->second(url, oeMsg);
+        } else {
+            throw std::invalid_argument("Unsupported operation: " + operationName);
+        }
+    }
+
+    Expected<std::string> tryExecute(const std::string& operationName, const std::string& request, const std::string& url, const CallContext& context) override {
+        auto it = functionMap.find(operationName);
+        if (it == functionMap.end()) {
+            return Error(ErrorCode::UnsupportedOperation, operationName);
+        }
+        if (context.isCancelled()) {
+            return Error(ErrorCode::Cancelled, operationName);
+        }
+        if (context.isExpired()) {
+            return Error(ErrorCode::DeadlineExceeded, operationName);
+        }
+        return it->second(url, convertToOeMsg(request));
+    }
+};
+
+// Define the XyzService and XyzAdapter classes similarly.
+struct XyzMsg {
+    std::string_view data;
+    std::string id;
+    std::string status;
+    long long count = 0;
+    double value = 0;
+};
+
+template <>
+struct MessageDescriptor<XyzMsg> {
+    static const std::vector<FieldDescriptor<XyzMsg>>& fields() {
+        static const std::vector<FieldDescriptor<XyzMsg>> descriptors = {
+            {"id", &XyzMsg::id},
+            {"status", &XyzMsg::status},
+            {"count", &XyzMsg::count},
+            {"value", &XyzMsg::value},
+        };
+        return descriptors;
+    }
+};
+
+inline std::string describe(const XyzMsg& xyzMsg) {
+    return xyzMsg.data.empty() ? describeMessage(xyzMsg) : std::string(xyzMsg.data);
+}
+
+class XyzService {
+public:
+    std::string create(const std::string& url, const XyzMsg& xyzMsg) {
+        return "XYZ created at " + url + ": " + describe(xyzMsg);
+    }
+
+    std::string read(const std::string& url, const XyzMsg& xyzMsg) {
+        return "XYZ read at " + url + ": " + describe(xyzMsg);
+    }
+
+    std::string newFunction(const std::string& url, const XyzMsg& xyzMsg) {
+        return "XYZ new function at " + url + ": " + describe(xyzMsg);
+    }
+};
+
+class XyzAdapter : public ServiceInterface, public TypedServiceInterface<XyzMsg> {
+private:
+    XyzService xyzService;
+    std::unordered_map<std::string, std::function<std::string(const std::string&, const XyzMsg&)>> functionMap;
+
+    XyzMsg convertToXyzMsg(std::string_view request) {
+        XyzMsg xyzMsg;
+        xyzMsg.data = request;
+        return xyzMsg;
+    }
+
+public:
+    XyzAdapter() {
+        functionMap["create"] = [this](const std::string& url, const XyzMsg& xyzMsg) {
+            return this->xyzService.create(url, xyzMsg);
+        };
+        functionMap["read"] = [this](const std::string& url, const XyzMsg& xyzMsg) {
+            return this->xyzService.read(url, xyzMsg);
+        };
+        functionMap["newFunction"] = [this](const std::string& url, const XyzMsg& xyzMsg) {
+            return this->xyzService.newFunction(url, xyzMsg);
+        };
+    }
+
+    XyzAdapter(const XyzAdapter&) = delete;
+    XyzAdapter& operator=(const XyzAdapter&) = delete;
+
+    using ServiceInterface::execute;
+
+    std::string execute(const std::string& operationName, const std::string& request, const std::string& url) override {
+        XyzMsg xyzMsg = convertToXyzMsg(request);
+        auto it = functionMap.find(operationName);
+        if (it != functionMap.end()) {
+            return it->second(url, xyzMsg);
+        } else {
+            throw std::invalid_argument("Unsupported operation: " + operationName);
+        }
+    }
+
+    std::string executeTyped(const std::string& operationName, const XyzMsg& xyzMsg, const std::string& url) override {
+        auto it = functionMap.find(operationName);
+        if (it != functionMap.end()) {
+            return it->second(url, xyzMsg);
+        } else {
+            throw std::invalid_argument("Unsupported operation: " + operationName);
+        }
+    }
+
+    Expected<std::string> tryExecute(const std::string& operationName, const std::string& request, const std::string& url, const CallContext& context) override {
+        auto it = functionMap.find(operationName);
+        if (it == functionMap.end()) {
+            return Error(ErrorCode::UnsupportedOperation, operationName);
+        }
+        if (context.isCancelled()) {
+            return Error(ErrorCode::Cancelled, operationName);
+        }
+        if (context.isExpired()) {
+            return Error(ErrorCode::DeadlineExceeded, operationName);
+        }
+        return it->second(url, convertToXyzMsg(request));
+    }
+};
+
+// Define the AdapterRegistry class: how to build each service's adapter, not the adapters
+// themselves. Factories are cheap to register; an adapter (and, for plugins, its shared
+// library) is only constructed when a factory first dispatches to that service.
+// Registration and lookup are thread-safe, so one registry can back many factories.
+class AdapterRegistry {
+public:
+    using AdapterFactory = std::function<std::unique_ptr<ServiceInterface>()>;
+
+private:
+    mutable std::mutex mutex;
+    std::unordered_map<std::string, AdapterFactory> factories;
+
+public:
+    // The built-in adapters; shared by every OperationFactory constructed without a registry.
+    static std::shared_ptr<AdapterRegistry> defaults() {
+        static std::shared_ptr<AdapterRegistry> registry = [] {
+            auto created = std::make_shared<AdapterRegistry>();
+            created->registerFactory("OEPY", [] { return std::make_unique<OeAdapter>(); });
+            created->registerFactory("XYZ", [] { return std::make_unique<XyzAdapter>(); });
+            return created;
+        }();
+        return registry;
+    }
+
+    // Add or replace a service; factories that already built the old adapter keep using it.
+    void registerFactory(const std::string& serviceName, AdapterFactory factory) {
+        std::lock_guard<std::mutex> lock(mutex);
+        factories[serviceName] = std::move(factory);
+    }
+
+    bool contains(const std::string& serviceName) const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return factories.count(serviceName) != 0;
+    }
+
+    size_t size() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return factories.size();
+    }
+
+    // The factory registered for a service, or an empty function; used to wrap adapters.
+    AdapterFactory factoryFor(const std::string& serviceName) const {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = factories.find(serviceName);
+        return it == factories.end() ? AdapterFactory{} : it->second;
+    }
+
+    // Build a new adapter, or return nullptr if the service is unknown.
+    std::unique_ptr<ServiceInterface> create(const std::string& serviceName) const {
+        AdapterFactory factory;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = factories.find(serviceName);
+            if (it == factories.end()) {
+                return nullptr;
+            }
+            factory = it->second;
+        }
+        return factory();
+    }
+};
+
+// One destination of a fan-out call, and what came back from it.
+struct FanOutTarget {
+    std::string serviceName;
+    std::string operationName;
+    std::string url;
+};
+
+struct FanOutResult {
+    std::string serviceName;
+    std::string operationName;
+    Expected<std::string> response;
+};
+
+// Function to combine fan-out results into one JSON array, in target order:
+// [{"service":"OEPY","operation":"create","response":"..."}, {"service":"XYZ",...,"error":"..."}]
+inline std::string combineResponses(const std::vector<FanOutResult>& results) {
+    std::string combined = "[";
+    for (size_t i = 0; i < results.size(); ++i) {
+        if (i > 0) {
+            combined += ",";
+        }
+        combined += "{\"service\":\"";
+        writeEscapedJson(combined, results[i].serviceName);
+        combined += "\",\"operation\":\"";
+        writeEscapedJson(combined, results[i].operationName);
+        if (results[i].response) {
+            combined += "\",\"response\":\"";
+            writeEscapedJson(combined, *results[i].response);
+        } else {
+            combined += "\",\"error\":\"";
+            writeEscapedJson(combined, results[i].response.error().message());
+        }
+        combined += "\"}";
+    }
+    combined += "]";
+    return combined;
+}
+
+// Define the OperationFactory class.
+// A factory and the adapters it owns are not thread-safe; use ShardedOperationFactory
+// (sharded_factory.hpp) to dispatch from several threads.
+class OperationFactory {
+private:
+    std::shared_ptr<const AdapterRegistry> registry;
+    std::unordered_map<std::string, std::unique_ptr<ServiceInterface>> serviceMap;
+
+    // The adapter for a service, built from the registry on first use; nullptr if unknown.
+    ServiceInterface* findService(const std::string& serviceName) {
+        auto it = serviceMap.find(serviceName);
+        if (it != serviceMap.end()) {
+            return it->second.get();
+        }
+        std::unique_ptr<ServiceInterface> created = registry->create(serviceName);
+        if (created == nullptr) {
+            return nullptr;
+        }
+        return serviceMap.emplace(serviceName, std::move(created)).first->second.get();
+    }
+
+    // Like findService, but an adapter that cannot be built (e.g. a plugin library that fails to
+    // load) comes back as ServiceFailed instead of an exception.
+    Expected<ServiceInterface*> tryFindService(const std::string& serviceName) {
+        try {
+            return findService(serviceName);
+        } catch (const std::exception& e) {
+            return Error(ErrorCode::ServiceFailed, e.what());
+        }
+    }
+
+public:
+    explicit OperationFactory(std::shared_ptr<const AdapterRegistry> registry = AdapterRegistry::defaults()) : registry(std::move(registry)) {}
+
+    // Adapters built so far.
+    size_t loadedServices() const {
+        return serviceMap.size();
+    }
+
+    // Add or replace the adapter used for a service, e.g. an HttpServiceAdapter.
+    void registerService(const std::string& serviceName, std::unique_ptr<ServiceInterface> service) {
+        serviceMap[serviceName] = std::move(service);
+    }
+
+    // Run an operation and return the service response.
+    std::string dispatch(const std::string& serviceName, const std::string& operationName, const std::string& url, const std::string& requestData) {
+        return dispatch(serviceName, operationName, url, requestData, CallContext{});
+    }
+
+    std::string dispatch(const std::string& serviceName, const std::string& operationName, const std::string& url, const std::string& requestData, const CallContext& context) {
+        ServiceInterface* service = findService(serviceName);
+        if (service != nullptr) {
+            TraceSpan span("execute", "adapter", serviceName);
+            return service->execute(operationName, requestData, url, context);
+        } else {
+            throw std::invalid_argument("Unsupported service: " + serviceName);
+        }
+    }
+
+    // Like dispatch, but unknown services and operations, and adapters that fail to load, come
+    // back as an Error instead of an exception.
+    Expected<std::string> tryDispatch(const std::string& serviceName, const std::string& operationName, const std::string& url, const std::string& requestData,
+                                      const CallContext& context = CallContext{}) {
+        auto service = tryFindService(serviceName);
+        if (!service) {
+            return service.error();
+        }
+        if (*service == nullptr) {
+            return Error(ErrorCode::UnsupportedService, serviceName);
+        }
+        TraceSpan span("execute", "adapter", serviceName);
+        return (*service)->tryExecute(operationName, requestData, url, context);
+    }
+
+    // Run an operation on a typed message. Adapters that accept Msg get it as is; any other
+    // adapter (a wrapper such as LimitedService, HedgedService, HttpServiceAdapter or a plugin)
+    // gets the message rendered as request text, and its deadline and limits apply as usual.
+    template <typename Msg>
+    std::string dispatchTyped(const std::string& serviceName, const std::string& operationName, const std::string& url, const Msg& message,
+                              const CallContext& context = CallContext{}) {
+        ServiceInterface* service = findService(serviceName);
+        if (service == nullptr) {
+            throw std::invalid_argument("Unsupported service: " + serviceName);
+        }
+        TraceSpan span("execute", "adapter", serviceName);
+        if (auto* typed = dynamic_cast<TypedServiceInterface<Msg>*>(service)) {
+            context.check(operationName);
+            return typed->executeTyped(operationName, message, url);
+        }
+        return service->execute(operationName, describeMessage(message), url, context);
+    }
+
+    // Send one request to several services at once. Every adapter reads the same requestData
+    // (nothing is copied per target) and distinct adapters run concurrently; targets that share
+    // an adapter run one after another, since an adapter is not thread-safe. The groups run on
+    // the shared WorkerPool and the calling thread, so no thread is started per record. Failures
+    // are reported per target rather than thrown.
+    std::vector<FanOutResult> fanOut(const std::vector<FanOutTarget>& targets, const std::string& requestData, const CallContext& context = CallContext{}) {
+        std::vector<FanOutResult> results;
+        results.reserve(targets.size());
+        std::vector<std::pair<ServiceInterface*, std::vector<size_t>>> groups;
+        for (size_t i = 0; i < targets.size(); ++i) {
+            results.push_back({targets[i].serviceName, targets[i].operationName, Error(ErrorCode::UnsupportedService, targets[i].serviceName)});
+            auto found = tryFindService(targets[i].serviceName);
+            if (!found) {
+                results[i].response = found.error();
+                continue;
+            }
+            ServiceInterface* service = *found;
+            if (service == nullptr) {
+                continue;
+            }
+            auto group = std::find_if(groups.begin(), groups.end(), [service](const auto& g) { return g.first == service; });
+            if (group == groups.end()) {
+                groups.emplace_back(service, std::vector<size_t>{i});
+            } else {
+                group->second.push_back(i);
+            }
+        }
+
+        TraceRecord trace = Tracer::currentRecord();
+        WorkerPool::shared().runAll(groups.size(), [&](size_t g) {
+            TraceRecordScope traceScope(trace);
+            for (size_t i : groups[g].second) {
+                TraceSpan span("execute", "adapter", targets[i].serviceName);
+                results[i].response = groups[g].first->tryExecute(targets[i].operationName, requestData, targets[i].url, context);
+            }
+        });
+        return results;
+    }
+
+    void performOperation(const std::string& serviceName, const std::string& operationName, const std::string& url, const std::string& requestData) {
+        performOperation(serviceName, operationName, url, requestData, CallContext{});
+    }
+
+    void performOperation(const std::string& serviceName, const std::string& operationName, const std::string& url, const std::string& requestData, const CallContext& context) {
+        std::string response = dispatch(serviceName, operationName, url, requestData, context);
+        std::cout << operationName << " Response: " << response << std::endl;
+    }
+};
+
+#endif // OPERATION_FACTORY_H
@@ -0,0 +1,319 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include "numa_placement.hpp"
+#include "ring_buffer.hpp"
+#include "trace.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Per-stage counters, readable while the pipeline runs.
+struct StageStats {
+    std::string name;
+    size_t threads = 0;
+    size_t queueDepth = 0;
+    size_t queueCapacity = 0;
+    uint64_t processed = 0;
+    uint64_t dropped = 0;
+    uint64_t failed = 0;     // the stage function threw
+    double recordsPerSecond = 0;
+};
+
+// Define the StagedPipeline class.
+// Items flow source -> stage 1 -> ... -> stage N -> sink. Stages are connected by bounded
+// MPMC rings, so a slow stage fills its inbox and every stage upstream of it (ultimately the
+// source) blocks instead of buffering without limit. The sink runs on one thread and sees
+// items in source order: it restores order in a fixed resequencing window, and the source is
+// not allowed more than reorderWindow items ahead of the oldest one not yet written, so one
+// slow item stalls ingest rather than letting everything behind it pile up. An item whose
+// stage function throws skips the remaining stages and reaches the failure sink, in order,
+// with the error text. With setPlacement, stage threads are pinned in the order they are
+// started (stage by stage) and allocate from their own node, each stage's inbox is moved to
+// the node of its first thread, and throughput is also reported per node.
+template <typename T>
+class StagedPipeline {
+public:
+    using Source = std::function<bool(T&)>;     // fill the item; false at end of input
+    using StageFn = std::function<bool(T&)>;    // false drops the item
+    using StageFactory = std::function<StageFn()>;  // called once per stage thread
+    using Sink = std::function<void(T&)>;
+    using FailureSink = std::function<void(T&, const std::string&)>;  // item and "<stage>: <what>"
+
+private:
+    struct Envelope {
+        uint64_t seq = 0;
+        bool dropped = false;
+        std::string error;  // set by the stage that threw; later stages pass the item through
+        T item{};
+    };
+
+    struct Stage {
+        std::string name;
+        size_t threads;
+        StageFactory factory;
+        MpmcRing<Envelope> inbox;
+        IdleWaiter ready;
+        std::atomic<uint64_t> processed{0};
+        std::atomic<uint64_t> dropped{0};
+        std::atomic<uint64_t> failed{0};
+        std::atomic<size_t> activeThreads{0};
+        std::atomic<bool> upstreamDone{false};
+
+        Stage(std::string name, size_t threads, StageFactory factory, size_t capacity)
+            : name(std::move(name)), threads(threads), factory(std::move(factory)), inbox(capacity) {}
+    };
+
+    const size_t queueCapacity;
+    const size_t reorderWindow;
+    std::vector<std::unique_ptr<Stage>> stages;
+    std::unique_ptr<MpmcRing<Envelope>> sinkInbox;
+    IdleWaiter sinkReady;
+    std::atomic<bool> sinkUpstreamDone{false};
+    std::atomic<uint64_t> ingested{0};
+    std::atomic<uint64_t> written{0};
+    std::atomic<uint64_t> nextToWrite{0};   // published by the sink; bounds how far ingest may run ahead
+    IdleWaiter sinkProgress;
+    const std::chrono::steady_clock::time_point startTime;
+    PlacementPolicy placementPolicy;
+    NodeCounters nodeProcessed;
+    static constexpr uint64_t kNodeCountBatch = 256;
+
+    // Push to ring, backing off (yield, then sleeps of up to 1 ms) while downstream is full.
+    static void pushBlocking(MpmcRing<Envelope>& ring, IdleWaiter& ready, Envelope& envelope) {
+        unsigned attempts = 0;
+        while (!ring.tryPush(envelope)) {
+            if (++attempts < kIdleYields) {
+                std::this_thread::yield();
+            } else {
+                std::this_thread::sleep_for(std::chrono::microseconds(std::min(1000u, 1u << std::min(attempts - kIdleYields, 10u))));
+            }
+        }
+        ready.notify();
+    }
+
+    // Pop from ring; returns false once upstream has finished and the ring is drained.
+    // An idle consumer spins briefly, then parks on ready until a producer wakes it.
+    static bool popBlocking(MpmcRing<Envelope>& ring, IdleWaiter& ready, const std::atomic<bool>& upstreamDone, Envelope& envelope) {
+        unsigned idle = 0;
+        for (;;) {
+            if (ring.tryPop(envelope)) {
+                return true;
+            }
+            if (upstreamDone.load(std::memory_order_acquire)) {
+                return ring.tryPop(envelope);
+            }
+            if (++idle < kIdleSpins) {
+                continue;
+            } else if (idle < kIdleSpins + kIdleYields) {
+                std::this_thread::yield();
+            } else {
+                ready.wait([&] { return ring.size() > 0 || upstreamDone.load(std::memory_order_acquire); });
+                idle = 0;
+            }
+        }
+    }
+
+    IdleWaiter& readyOf(size_t stageIndex) {
+        return stageIndex + 1 < stages.size() ? stages[stageIndex + 1]->ready : sinkReady;
+    }
+
+    MpmcRing<Envelope>& outputOf(size_t stageIndex) {
+        return stageIndex + 1 < stages.size() ? stages[stageIndex + 1]->inbox : *sinkInbox;
+    }
+
+    std::atomic<bool>& doneFlagAfter(size_t stageIndex) {
+        return stageIndex + 1 < stages.size() ? stages[stageIndex + 1]->upstreamDone : sinkUpstreamDone;
+    }
+
+    void runStage(size_t stageIndex, Placement placement, bool firstOfStage) {
+        Stage& stage = *stages[stageIndex];
+        Tracer::setThreadName(stage.name);
+        if (placementPolicy.enabled()) {
+            applyPlacement(placement, placementPolicy.localMemory);
+            if (placementPolicy.localMemory && firstOfStage) {
+                bindToNode(stage.inbox.storage(), stage.inbox.storageBytes(), placement.node);
+            }
+        }
+        // Called after placement so whatever the stage allocates per thread is node-local.
+        StageFn fn = stage.factory();
+        // Per-node counts are kept locally and published in batches, so stage threads do not
+        // all add to the same node counter on every item.
+        const bool counting = placementPolicy.enabled();
+        uint64_t uncounted = 0;
+        Envelope envelope;
+        while (popBlocking(stage.inbox, stage.ready, stage.upstreamDone, envelope)) {
+            if (!envelope.dropped && envelope.error.empty()) {
+                try {
+                    envelope.dropped = !fn(envelope.item);
+                    if (envelope.dropped) {
+                        stage.dropped.fetch_add(1, std::memory_order_relaxed);
+                    }
+                } catch (const std::exception& e) {
+                    envelope.error = stage.name + ": " + e.what();
+                } catch (...) {
+                    envelope.error = stage.name + ": unknown exception";
+                }
+                if (!envelope.error.empty()) {
+                    stage.failed.fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+            stage.processed.fetch_add(1, std::memory_order_relaxed);
+            if (counting && ++uncounted == kNodeCountBatch) {
+                nodeProcessed.add(placement.node, uncounted);
+                uncounted = 0;
+            }
+            pushBlocking(outputOf(stageIndex), readyOf(stageIndex), envelope);
+        }
+        if (uncounted > 0) {
+            nodeProcessed.add(placement.node, uncounted);
+        }
+        // The last thread out tells the next stage that nothing more is coming.
+        if (stage.activeThreads.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            doneFlagAfter(stageIndex).store(true, std::memory_order_release);
+            readyOf(stageIndex).notifyAll();
+        }
+    }
+
+    void runSink(const Sink& sink, const FailureSink& failureSink) {
+        // Stages with several threads finish items out of order; hold them until their turn.
+        // Ingest never runs more than reorderWindow items past `next`, so seq - next < reorderWindow
+        // and slot seq % reorderWindow is free.
+        std::vector<Envelope> window(reorderWindow);
+        std::vector<bool> filled(reorderWindow, false);
+        uint64_t next = 0;
+        Envelope envelope;
+        while (popBlocking(*sinkInbox, sinkReady, sinkUpstreamDone, envelope)) {
+            size_t slot = static_cast<size_t>(envelope.seq % reorderWindow);
+            window[slot] = std::move(envelope);
+            filled[slot] = true;
+            uint64_t before = next;
+            for (slot = static_cast<size_t>(next % reorderWindow); filled[slot]; slot = static_cast<size_t>(next % reorderWindow)) {
+                if (!window[slot].error.empty()) {
+                    if (failureSink) {
+                        failureSink(window[slot].item, window[slot].error);
+                    }
+                } else if (!window[slot].dropped) {
+                    sink(window[slot].item);
+                    written.fetch_add(1, std::memory_order_relaxed);
+                }
+                window[slot].item = T{};
+                window[slot].error.clear();
+                filled[slot] = false;
+                ++next;
+            }
+            if (next != before) {
+                nextToWrite.store(next, std::memory_order_release);
+                sinkProgress.notify();
+            }
+        }
+    }
+
+public:
+    // reorderWindow 0 means 4 x queueCapacity.
+    explicit StagedPipeline(size_t queueCapacity = 1024, size_t reorderWindow = 0)
+        : queueCapacity(queueCapacity), reorderWindow(reorderWindow > 0 ? reorderWindow : 4 * queueCapacity), sinkInbox(std::make_unique<MpmcRing<Envelope>>(queueCapacity)),
+          startTime(std::chrono::steady_clock::now()) {}
+
+    StagedPipeline(const StagedPipeline&) = delete;
+    StagedPipeline& operator=(const StagedPipeline&) = delete;
+
+    void addStage(const std::string& name, size_t threads, StageFactory factory) {
+        if (threads == 0) {
+            throw std::invalid_argument("Stage " + name + " needs at least one thread");
+        }
+        stages.push_back(std::make_unique<Stage>(name, threads, std::move(factory), queueCapacity));
+    }
+
+    // Set before run(); PlacementPolicy::Mode::Off (the default) leaves threads unpinned.
+    void setPlacement(PlacementPolicy policy) {
+        placementPolicy = policy;
+    }
+
+    // Run the pipeline to completion. The source is driven on the calling thread. Items a stage
+    // threw on go to failureSink if given; either way they are counted as failed, not dropped.
+    void run(const Source& source, const Sink& sink, const FailureSink& failureSink = nullptr) {
+        if (stages.empty()) {
+            throw std::logic_error("StagedPipeline has no stages");
+        }
+        std::vector<std::thread> workers;
+        size_t workerIndex = 0;
+        for (size_t i = 0; i < stages.size(); ++i) {
+            stages[i]->activeThreads.store(stages[i]->threads, std::memory_order_relaxed);
+            for (size_t t = 0; t < stages[i]->threads; ++t) {
+                Placement placement = placementFor(placementPolicy, workerIndex++);
+                workers.emplace_back([this, i, placement, t] { runStage(i, placement, t == 0); });
+            }
+        }
+        std::thread sinkThread([this, &sink, &failureSink] { runSink(sink, failureSink); });
+
+        Envelope envelope;
+        uint64_t seq = 0;
+        for (;;) {
+            envelope.item = T{};
+            if (!source(envelope.item)) {
+                break;
+            }
+            auto withinWindow = [&] { return seq - nextToWrite.load(std::memory_order_acquire) < reorderWindow; };
+            while (!withinWindow()) {
+                sinkProgress.wait(withinWindow);
+            }
+            envelope.seq = seq++;
+            envelope.dropped = false;
+            envelope.error.clear();
+            pushBlocking(stages.front()->inbox, stages.front()->ready, envelope);
+            ingested.fetch_add(1, std::memory_order_relaxed);
+        }
+        stages.front()->upstreamDone.store(true, std::memory_order_release);
+        stages.front()->ready.notifyAll();
+
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        sinkThread.join();
+    }
+
+    std::vector<StageStats> stats() const {
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+        std::vector<StageStats> result;
+        for (const auto& stage : stages) {
+            StageStats s;
+            s.name = stage->name;
+            s.threads = stage->threads;
+            s.queueDepth = stage->inbox.size();
+            s.queueCapacity = stage->inbox.capacity();
+            s.processed = stage->processed.load(std::memory_order_relaxed);
+            s.dropped = stage->dropped.load(std::memory_order_relaxed);
+            s.failed = stage->failed.load(std::memory_order_relaxed);
+            s.recordsPerSecond = elapsed > 0 ? s.processed / elapsed : 0;
+            result.push_back(s);
+        }
+        return result;
+    }
+
+    void report(std::ostream& out) const {
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+        out << "ingest: " << ingested.load() << " records\n";
+        for (const auto& s : stats()) {
+            out << s.name << " x" << s.threads << ": " << s.processed << " processed, " << s.dropped << " dropped, " << s.failed << " failed, queue "
+                << s.queueDepth << "/" << s.queueCapacity << ", " << static_cast<uint64_t>(s.recordsPerSecond) << " rec/s\n";
+        }
+        out << "write: " << written.load() << " records, "
+            << static_cast<uint64_t>(elapsed > 0 ? written.load() / elapsed : 0) << " rec/s\n";
+        if (placementPolicy.enabled()) {
+            nodeProcessed.report("stages", elapsed, out);
+        }
+    }
+};
+
+#endif // PIPELINE_H
@@ -0,0 +1,225 @@
+#ifndef RING_BUFFER_H
+#define RING_BUFFER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <utility>
+
+// Bounded lock-free ring buffers used to hand work between threads.
+// Capacities are rounded up to a power of two; T must be default-constructible and movable.
+
+constexpr size_t kCacheLine = 64;
+
+inline size_t roundUpToPowerOfTwo(size_t n) {
+    size_t capacity = 2;
+    while (capacity < n) {
+        capacity <<= 1;
+    }
+    return capacity;
+}
+
+// Define the SpscRing class: one producer thread, one consumer thread.
+template <typename T>
+class SpscRing {
+private:
+    const size_t mask;
+    std::unique_ptr<T[]> slots;
+    alignas(kCacheLine) std::atomic<size_t> head{0};  // next slot to read, owned by the consumer
+    alignas(kCacheLine) size_t cachedTail = 0;
+    alignas(kCacheLine) std::atomic<size_t> tail{0};  // next slot to write, owned by the producer
+    alignas(kCacheLine) size_t cachedHead = 0;
+
+public:
+    explicit SpscRing(size_t capacity)
+        : mask(roundUpToPowerOfTwo(capacity) - 1), slots(new T[mask + 1]) {}
+
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    bool tryPush(T& value) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t - cachedHead > mask) {
+            cachedHead = head.load(std::memory_order_acquire);
+            if (t - cachedHead > mask) {
+                return false;
+            }
+        }
+        slots[t & mask] = std::move(value);
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool tryPop(T& value) {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h == cachedTail) {
+            cachedTail = tail.load(std::memory_order_acquire);
+            if (h == cachedTail) {
+                return false;
+            }
+        }
+        value = std::move(slots[h & mask]);
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    size_t size() const {
+        return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+    }
+
+    size_t capacity() const {
+        return mask + 1;
+    }
+
+    // The slot array, e.g. to bind it to the consumer's NUMA node.
+    const void* storage() const {
+        return slots.get();
+    }
+
+    size_t storageBytes() const {
+        return (mask + 1) * sizeof(T);
+    }
+};
+
+// Define the MpmcRing class: any number of producers and consumers.
+// Each slot carries a sequence number (Vyukov's bounded queue), so producers only contend on
+// the tail counter and consumers only on the head counter.
+template <typename T>
+class MpmcRing {
+private:
+    struct alignas(kCacheLine) Slot {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    const size_t mask;
+    std::unique_ptr<Slot[]> slots;
+    alignas(kCacheLine) std::atomic<size_t> head{0};
+    alignas(kCacheLine) std::atomic<size_t> tail{0};
+
+public:
+    explicit MpmcRing(size_t capacity)
+        : mask(roundUpToPowerOfTwo(capacity) - 1), slots(new Slot[mask + 1]) {
+        for (size_t i = 0; i <= mask; ++i) {
+            slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    MpmcRing(const MpmcRing&) = delete;
+    MpmcRing& operator=(const MpmcRing&) = delete;
+
+    bool tryPush(T& value) {
+        size_t pos = tail.load(std::memory_order_relaxed);
+        for (;;) {
+            Slot& slot = slots[pos & mask];
+            size_t seq = slot.sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    slot.value = std::move(value);
+                    slot.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;  // full
+            } else {
+                pos = tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool tryPop(T& value) {
+        size_t pos = head.load(std::memory_order_relaxed);
+        for (;;) {
+            Slot& slot = slots[pos & mask];
+            size_t seq = slot.sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+            if (diff == 0) {
+                if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    value = std::move(slot.value);
+                    slot.sequence.store(pos + mask + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;  // empty
+            } else {
+                pos = head.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Approximate: producers and consumers may be mid-operation.
+    size_t size() const {
+        size_t t = tail.load(std::memory_order_acquire);
+        size_t h = head.load(std::memory_order_acquire);
+        return t > h ? t - h : 0;
+    }
+
+    size_t capacity() const {
+        return mask + 1;
+    }
+
+    const void* storage() const {
+        return slots.get();
+    }
+
+    size_t storageBytes() const {
+        return (mask + 1) * sizeof(Slot);
+    }
+};
+
+// Several producers feeding one worker use the MPMC ring; a single consumer never contends on head.
+template <typename T>
+using MpscRing = MpmcRing<T>;
+
+// Define the IdleWaiter class: lets a consumer that keeps finding its ring empty park instead of
+// spinning, and lets producers wake it. While nobody is parked, notify() is a fence and one
+// load. The consumer re-checks its condition under the mutex after announcing itself, and a
+// producer that sees a parked consumer takes the same mutex to notify, so no wake-up is lost.
+class IdleWaiter {
+private:
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::atomic<int> parked{0};
+
+public:
+    // Call after making the condition true (e.g. after a successful tryPush).
+    void notify() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (parked.load(std::memory_order_relaxed) > 0) {
+            std::lock_guard<std::mutex> lock(mutex);
+            wake.notify_one();
+        }
+    }
+
+    // Call when a condition every waiter must see changes (shutdown, end of input).
+    void notifyAll() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (parked.load(std::memory_order_relaxed) > 0) {
+            std::lock_guard<std::mutex> lock(mutex);
+            wake.notify_all();
+        }
+    }
+
+    // Park until ready() holds, or at most timeout (a safety net; wake-ups do not rely on it).
+    template <typename Ready>
+    void wait(Ready&& ready, std::chrono::milliseconds timeout = std::chrono::milliseconds(100)) {
+        std::unique_lock<std::mutex> lock(mutex);
+        parked.fetch_add(1, std::memory_order_seq_cst);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        wake.wait_for(lock, timeout, ready);
+        parked.fetch_sub(1, std::memory_order_relaxed);
+    }
+};
+
+// Number of empty polls a consumer spins, then yields, before it parks on its IdleWaiter.
+constexpr unsigned kIdleSpins = 64;
+constexpr unsigned kIdleYields = 64;
+
+#endif // RING_BUFFER_H
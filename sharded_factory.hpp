@@ -0,0 +1,196 @@
+#ifndef SHARDED_FACTORY_H
+#define SHARDED_FACTORY_H
+
+#include "numa_placement.hpp"
+#include "operation_factory.hpp"
+#include "ring_buffer.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <future>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// A request handed to a shard, with the promise the worker fulfils.
+struct DispatchRequest {
+    std::string serviceName;
+    std::string operationName;
+    std::string url;
+    std::string requestData;
+    std::promise<std::string> reply;
+    Deadline deadline = Deadline::max();
+};
+
+// Define the ShardedOperationFactory class.
+// Each shard is one worker thread that owns its own OperationFactory (and therefore its own
+// adapter instances) plus a bounded inbox. Callers only touch the inbox of the shard their
+// (service, url) hashes to, so nothing mutable is shared on the call path.
+// With a PlacementPolicy, shard i is pinned to a CPU chosen by placementFor(policy, i); its
+// factory and adapters are then allocated on that CPU's node and its inbox is moved there.
+class ShardedOperationFactory {
+private:
+    struct Shard {
+        MpscRing<DispatchRequest> inbox;
+        IdleWaiter ready;
+        std::thread worker;
+        Placement placement;
+        // Written only by the worker, and only with placement on; on its own cache line so
+        // neither callers pushing to the inbox nor other shards' workers share it.
+        alignas(64) std::atomic<uint64_t> served{0};
+
+        explicit Shard(size_t queueCapacity) : inbox(queueCapacity) {}
+    };
+
+    std::vector<std::unique_ptr<Shard>> shards;
+    std::atomic<bool> running{true};
+    const PlacementPolicy placementPolicy;
+    const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+
+    static uint64_t hashRoute(std::string_view serviceName, std::string_view url) {
+        uint64_t hash = 1469598103934665603ULL;  // FNV-1a
+        for (char c : serviceName) {
+            hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211ULL;
+        }
+        hash = (hash ^ 0xff) * 1099511628211ULL;
+        for (char c : url) {
+            hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211ULL;
+        }
+        return hash;
+    }
+
+    static void serve(OperationFactory& factory, DispatchRequest& request) {
+        try {
+            // Requests that expired while queued fail here without reaching the adapter.
+            CallContext context{request.deadline, nullptr};
+            request.reply.set_value(factory.dispatch(request.serviceName, request.operationName, request.url, request.requestData, context));
+        } catch (...) {
+            request.reply.set_exception(std::current_exception());
+        }
+    }
+
+    void run(Shard& shard) {
+        if (placementPolicy.enabled()) {
+            applyPlacement(shard.placement, placementPolicy.localMemory);
+            if (placementPolicy.localMemory) {
+                bindToNode(shard.inbox.storage(), shard.inbox.storageBytes(), shard.placement.node);
+            }
+        }
+        // Built on the worker thread so the adapters live next to the core that uses them.
+        OperationFactory factory;
+        DispatchRequest request;
+        const bool counting = placementPolicy.enabled();
+        unsigned idleSpins = 0;
+        while (running.load(std::memory_order_acquire)) {
+            if (shard.inbox.tryPop(request)) {
+                serve(factory, request);
+                if (counting) {
+                    shard.served.store(shard.served.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                }
+                idleSpins = 0;
+            } else if (++idleSpins < kIdleSpins) {
+                continue;
+            } else if (idleSpins < kIdleSpins + kIdleYields) {
+                std::this_thread::yield();
+            } else {
+                // Idle: sleep until submit() wakes us rather than holding the core.
+                shard.ready.wait([&] { return shard.inbox.size() > 0 || !running.load(std::memory_order_acquire); });
+                idleSpins = 0;
+            }
+        }
+        // Drain whatever was accepted before shutdown.
+        while (shard.inbox.tryPop(request)) {
+            serve(factory, request);
+        }
+    }
+
+public:
+    explicit ShardedOperationFactory(size_t shardCount = std::thread::hardware_concurrency(), size_t queueCapacity = 1024,
+                                     PlacementPolicy placement = PlacementPolicy{})
+        : placementPolicy(placement) {
+        if (shardCount == 0) {
+            shardCount = 1;
+        }
+        for (size_t i = 0; i < shardCount; ++i) {
+            shards.push_back(std::make_unique<Shard>(queueCapacity));
+            shards.back()->placement = placementFor(placementPolicy, i);
+        }
+        for (auto& shard : shards) {
+            Shard* s = shard.get();
+            s->worker = std::thread([this, s] { run(*s); });
+        }
+    }
+
+    ShardedOperationFactory(const ShardedOperationFactory&) = delete;
+    ShardedOperationFactory& operator=(const ShardedOperationFactory&) = delete;
+
+    ~ShardedOperationFactory() {
+        running.store(false, std::memory_order_release);
+        for (auto& shard : shards) {
+            shard->ready.notifyAll();
+        }
+        for (auto& shard : shards) {
+            shard->worker.join();
+        }
+    }
+
+    size_t shardCount() const {
+        return shards.size();
+    }
+
+    size_t shardFor(std::string_view serviceName, std::string_view url) const {
+        return hashRoute(serviceName, url) % shards.size();
+    }
+
+    // Hand a request to its shard without blocking. Returns false when the shard's inbox is full.
+    bool trySubmit(DispatchRequest& request) {
+        if (!running.load(std::memory_order_acquire)) {
+            throw std::runtime_error("ShardedOperationFactory is shutting down");
+        }
+        Shard& shard = *shards[shardFor(request.serviceName, request.url)];
+        if (!shard.inbox.tryPush(request)) {
+            return false;
+        }
+        shard.ready.notify();
+        return true;
+    }
+
+    // Hand a request to its shard, yielding while the inbox is full.
+    std::future<std::string> submit(const std::string& serviceName, const std::string& operationName, const std::string& url, const std::string& requestData,
+                                    Deadline deadline = Deadline::max()) {
+        DispatchRequest request{serviceName, operationName, url, requestData, {}, deadline};
+        std::future<std::string> response = request.reply.get_future();
+        while (!trySubmit(request)) {
+            std::this_thread::yield();
+        }
+        return response;
+    }
+
+    std::string performOperation(const std::string& serviceName, const std::string& operationName, const std::string& url, const std::string& requestData,
+                                 Deadline deadline = Deadline::max()) {
+        return submit(serviceName, operationName, url, requestData, deadline).get();
+    }
+
+    size_t queueDepth(size_t shard) const {
+        return shards.at(shard)->inbox.size();
+    }
+
+    // Requests served per NUMA node since construction; counted only with a placement policy.
+    void report(std::ostream& out) const {
+        if (!placementPolicy.enabled()) {
+            out << "dispatch: per-node counts need a placement policy\n";
+            return;
+        }
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+        NodeCounters served;
+        for (const auto& shard : shards) {
+            served.add(shard->placement.node, shard->served.load(std::memory_order_relaxed));
+        }
+        served.report("dispatch", elapsed, out);
+    }
+};
+
+#endif // SHARDED_FACTORY_H
@@ -0,0 +1,499 @@
+#ifndef TAPE_CACHE_H
+#define TAPE_CACHE_H
+
+#include "json_pack.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <charconv>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+
+// On-disk caches that are mmapped at startup and read in place:
+//   - a compiled transformation plan (output field -> pre-tokenized source path), and
+//   - a document tape: a JSONValue tree flattened into fixed-size nodes with skip links.
+// All references inside a file are offsets from its start, so a file is position independent.
+// Files record the size and mtime of the source they were built from and are rebuilt when
+// either changes or the format version moves.
+
+constexpr char kTapeCacheMagic[4] = {'J', 'T', 'C', 'F'};
+constexpr uint32_t kTapeCacheVersion = 2;  // 2: plan fields and paths are stored JSON-decoded
+constexpr uint32_t kNoArrayIndex = 0xffffffffu;
+
+enum class CacheKind : uint32_t { Plan = 1, Tape = 2 };
+
+struct CacheHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t kind;
+    uint32_t count;          // plan entries or tape nodes
+    uint64_t fileSize;
+    uint64_t sourceSize;
+    int64_t sourceMtimeNs;
+    uint64_t recordsOffset;  // PlanEntry[] or TapeNode[]
+    uint64_t extraOffset;    // PlanStep[] for plans; unused for tapes
+    uint64_t extraCount;
+    uint64_t stringsOffset;
+    uint64_t stringsSize;
+};
+
+struct PlanEntry {
+    uint32_t fieldOffset;
+    uint32_t fieldLength;
+    uint32_t pathOffset;
+    uint32_t pathLength;
+    uint32_t firstStep;
+    uint32_t stepCount;
+};
+
+struct PlanStep {
+    uint32_t keyOffset;
+    uint32_t keyLength;
+    uint32_t arrayIndex;     // kNoArrayIndex when the token has no [index]
+    uint32_t reserved;
+};
+
+enum class TapeType : uint32_t { Object = 1, Array = 2, Key = 3, String = 4, Literal = 5 };
+
+struct TapeNode {
+    uint32_t type;
+    uint32_t length;         // children for containers, bytes for text
+    uint64_t payload;        // node index after the container, or offset of text in the pool
+};
+
+// Function to read a source file's size and modification time.
+inline std::pair<uint64_t, int64_t> sourceStamp(const std::string& path) {
+    struct stat info {};
+    if (::stat(path.c_str(), &info) != 0) {
+        throw std::runtime_error("Cannot stat " + path + ": " + std::strerror(errno));
+    }
+    return {static_cast<uint64_t>(info.st_size), static_cast<int64_t>(info.st_mtim.tv_sec) * 1000000000LL + info.st_mtim.tv_nsec};
+}
+
+// Define the MappedFile class: a read-only private mapping of a whole file.
+class MappedFile {
+private:
+    const char* data = nullptr;
+    size_t length = 0;
+
+public:
+    explicit MappedFile(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            throw std::runtime_error("Cannot open " + path + ": " + std::strerror(errno));
+        }
+        struct stat info {};
+        if (::fstat(fd, &info) != 0 || info.st_size == 0) {
+            ::close(fd);
+            throw std::runtime_error("Cannot map empty or unreadable file " + path);
+        }
+        length = static_cast<size_t>(info.st_size);
+        void* mapped = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (mapped == MAP_FAILED) {
+            throw std::runtime_error("Cannot mmap " + path + ": " + std::strerror(errno));
+        }
+        data = static_cast<const char*>(mapped);
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile() {
+        if (data != nullptr) {
+            ::munmap(const_cast<char*>(data), length);
+        }
+    }
+
+    const char* bytes() const {
+        return data;
+    }
+
+    size_t size() const {
+        return length;
+    }
+};
+
+// Define the CacheWriter class: builds a cache image in memory and writes it atomically.
+class CacheWriter {
+private:
+    std::string strings;
+    std::unordered_map<std::string, uint32_t> interned;
+
+public:
+    uint32_t intern(std::string_view text) {
+        auto it = interned.find(std::string(text));
+        if (it != interned.end()) {
+            return it->second;
+        }
+        uint32_t offset = static_cast<uint32_t>(strings.size());
+        strings.append(text);
+        interned.emplace(std::string(text), offset);
+        return offset;
+    }
+
+    template <typename Record, typename Extra>
+    void write(const std::string& path, CacheKind kind, const std::string& sourcePath, const std::vector<Record>& records, const std::vector<Extra>& extra) {
+        CacheHeader header{};
+        std::memcpy(header.magic, kTapeCacheMagic, sizeof(header.magic));
+        header.version = kTapeCacheVersion;
+        header.kind = static_cast<uint32_t>(kind);
+        header.count = static_cast<uint32_t>(records.size());
+        auto stamp = sourceStamp(sourcePath);
+        header.sourceSize = stamp.first;
+        header.sourceMtimeNs = stamp.second;
+        header.recordsOffset = sizeof(CacheHeader);
+        header.extraOffset = header.recordsOffset + records.size() * sizeof(Record);
+        header.extraCount = extra.size();
+        header.stringsOffset = header.extraOffset + extra.size() * sizeof(Extra);
+        header.stringsSize = strings.size();
+        header.fileSize = header.stringsOffset + strings.size();
+
+        std::string image(header.fileSize, '\0');
+        std::memcpy(image.data(), &header, sizeof(header));
+        if (!records.empty()) {
+            std::memcpy(image.data() + header.recordsOffset, records.data(), records.size() * sizeof(Record));
+        }
+        if (!extra.empty()) {
+            std::memcpy(image.data() + header.extraOffset, extra.data(), extra.size() * sizeof(Extra));
+        }
+        std::memcpy(image.data() + header.stringsOffset, strings.data(), strings.size());
+
+        // Write beside the target and rename, so a reader never maps a half-written file.
+        std::string temporary = path + ".tmp." + std::to_string(::getpid());
+        FILE* file = std::fopen(temporary.c_str(), "wb");
+        if (file == nullptr) {
+            throw std::runtime_error("Cannot create " + temporary + ": " + std::strerror(errno));
+        }
+        bool ok = std::fwrite(image.data(), 1, image.size(), file) == image.size();
+        ok = std::fclose(file) == 0 && ok;
+        if (!ok || std::rename(temporary.c_str(), path.c_str()) != 0) {
+            std::remove(temporary.c_str());
+            throw std::runtime_error("Cannot write cache " + path);
+        }
+    }
+};
+
+// Function to check a mapped cache file and return its header, or nullptr if it is stale or
+// not a cache of the expected kind. Throws only for corrupt files.
+inline const CacheHeader* validateCache(const MappedFile& file, CacheKind kind, const std::string& sourcePath, size_t recordSize, size_t extraSize) {
+    if (file.size() < sizeof(CacheHeader)) {
+        return nullptr;
+    }
+    const CacheHeader* header = reinterpret_cast<const CacheHeader*>(file.bytes());
+    if (std::memcmp(header->magic, kTapeCacheMagic, sizeof(header->magic)) != 0 || header->version != kTapeCacheVersion ||
+        header->kind != static_cast<uint32_t>(kind)) {
+        return nullptr;
+    }
+    auto stamp = sourceStamp(sourcePath);
+    if (header->sourceSize != stamp.first || header->sourceMtimeNs != stamp.second) {
+        return nullptr;
+    }
+    if (header->fileSize != file.size() ||
+        header->recordsOffset + uint64_t(header->count) * recordSize > header->extraOffset ||
+        header->extraOffset + header->extraCount * extraSize > header->stringsOffset ||
+        header->stringsOffset + header->stringsSize > header->fileSize) {
+        throw std::runtime_error("Corrupt cache file for " + sourcePath);
+    }
+    return header;
+}
+
+// Define the PlanView class: a compiled transformation plan read in place from a mapping.
+class PlanView {
+private:
+    const char* base = nullptr;
+    const CacheHeader* header = nullptr;
+
+    const PlanEntry& entry(size_t index) const {
+        return reinterpret_cast<const PlanEntry*>(base + header->recordsOffset)[index];
+    }
+
+    std::string_view text(uint32_t offset, uint32_t length) const {
+        return {base + header->stringsOffset + offset, length};
+    }
+
+public:
+    PlanView() = default;
+    PlanView(const char* base, const CacheHeader* header) : base(base), header(header) {
+        for (size_t i = 0; i < size(); ++i) {
+            const PlanEntry& e = entry(i);
+            if (uint64_t(e.firstStep) + e.stepCount > header->extraCount ||
+                uint64_t(e.fieldOffset) + e.fieldLength > header->stringsSize ||
+                uint64_t(e.pathOffset) + e.pathLength > header->stringsSize) {
+                throw std::runtime_error("Corrupt plan cache entry");
+            }
+        }
+    }
+
+    size_t size() const {
+        return header == nullptr ? 0 : header->count;
+    }
+
+    std::string_view field(size_t index) const {
+        return text(entry(index).fieldOffset, entry(index).fieldLength);
+    }
+
+    std::string_view path(size_t index) const {
+        return text(entry(index).pathOffset, entry(index).pathLength);
+    }
+
+    size_t stepCount(size_t index) const {
+        return entry(index).stepCount;
+    }
+
+    std::string_view stepKey(size_t index, size_t step) const {
+        const PlanStep& s = reinterpret_cast<const PlanStep*>(base + header->extraOffset)[entry(index).firstStep + step];
+        return text(s.keyOffset, s.keyLength);
+    }
+
+    uint32_t stepArrayIndex(size_t index, size_t step) const {
+        return reinterpret_cast<const PlanStep*>(base + header->extraOffset)[entry(index).firstStep + step].arrayIndex;
+    }
+
+    // For code that still wants the parseTransformationJson shape.
+    std::unordered_map<std::string, std::string> toMapping() const {
+        std::unordered_map<std::string, std::string> mapping;
+        for (size_t i = 0; i < size(); ++i) {
+            mapping.emplace(std::string(field(i)), std::string(path(i)));
+        }
+        return mapping;
+    }
+};
+
+// Function to read the index out of a "[n]" path suffix; false unless it is all digits and fits.
+template <typename Index>
+inline bool parseArrayIndex(std::string_view suffix, Index& index) {
+    if (suffix.size() < 3 || suffix.front() != '[' || suffix.back() != ']') {
+        return false;
+    }
+    const char* last = suffix.data() + suffix.size() - 1;
+    auto [end, error] = std::from_chars(suffix.data() + 1, last, index);
+    return error == std::errc() && end == last;
+}
+
+// Function to write a compiled plan for a mapping parsed from sourcePath.
+inline void writePlanCache(const std::string& cachePath, const std::string& sourcePath, const std::unordered_map<std::string, std::string>& mapping) {
+    CacheWriter writer;
+    std::vector<PlanEntry> entries;
+    std::vector<PlanStep> steps;
+    for (const auto& pair : mapping) {
+        PlanEntry entry{};
+        entry.fieldOffset = writer.intern(pair.first);
+        entry.fieldLength = static_cast<uint32_t>(pair.first.size());
+        entry.pathOffset = writer.intern(pair.second);
+        entry.pathLength = static_cast<uint32_t>(pair.second.size());
+        entry.firstStep = static_cast<uint32_t>(steps.size());
+        std::string_view path = pair.second;
+        size_t start = 0;
+        for (;;) {
+            size_t end = path.find('.', start);
+            std::string_view token = path.substr(start, end == std::string_view::npos ? std::string_view::npos : end - start);
+            PlanStep step{};
+            step.arrayIndex = kNoArrayIndex;
+            size_t bracket = token.find('[');
+            if (bracket != std::string_view::npos) {
+                uint32_t index = 0;
+                if (!parseArrayIndex(token.substr(bracket), index) || index == kNoArrayIndex) {
+                    throw std::runtime_error("Invalid array index in path " + pair.second);
+                }
+                step.arrayIndex = index;
+                token = token.substr(0, bracket);
+            }
+            step.keyOffset = writer.intern(token);
+            step.keyLength = static_cast<uint32_t>(token.size());
+            steps.push_back(step);
+            if (end == std::string_view::npos) {
+                break;
+            }
+            start = end + 1;
+        }
+        entry.stepCount = static_cast<uint32_t>(steps.size() - entry.firstStep);
+        entries.push_back(entry);
+    }
+    writer.write(cachePath, CacheKind::Plan, sourcePath, entries, steps);
+}
+
+// Define the TapeView class: a document tape read in place.
+class TapeView {
+private:
+    const char* base = nullptr;
+    const CacheHeader* header = nullptr;
+
+    const TapeNode& node(size_t index) const {
+        return reinterpret_cast<const TapeNode*>(base + header->recordsOffset)[index];
+    }
+
+    size_t next(size_t index) const {
+        TapeType type = static_cast<TapeType>(node(index).type);
+        return type == TapeType::Object || type == TapeType::Array ? node(index).payload : index + 1;
+    }
+
+public:
+    TapeView() = default;
+    TapeView(const char* base, const CacheHeader* header) : base(base), header(header) {
+        for (size_t i = 0; i < header->count; ++i) {
+            const TapeNode& n = node(i);
+            TapeType type = static_cast<TapeType>(n.type);
+            bool container = type == TapeType::Object || type == TapeType::Array;
+            if ((container && (n.payload <= i || n.payload > header->count)) ||
+                (!container && n.payload + n.length > header->stringsSize)) {
+                throw std::runtime_error("Corrupt document tape node");
+            }
+        }
+    }
+
+    TapeType type(size_t index) const {
+        return static_cast<TapeType>(node(index).type);
+    }
+
+    // String contents, or the literal text of a number, boolean or null.
+    std::string_view text(size_t index) const {
+        return {base + header->stringsOffset + node(index).payload, node(index).length};
+    }
+
+    // Same path syntax as extractValue ("a.b[1].c"); returns the node index, if present.
+    // A tape whose objects do not alternate keys and values, or whose members or elements run
+    // past their container, finds nothing rather than reading outside it.
+    std::optional<size_t> find(std::string_view path) const {
+        if (header == nullptr || header->count == 0) {
+            return std::nullopt;
+        }
+        size_t current = 0;
+        size_t start = 0;
+        for (;;) {
+            size_t end = path.find('.', start);
+            std::string_view token = path.substr(start, end == std::string_view::npos ? std::string_view::npos : end - start);
+            size_t bracket = token.find('[');
+            std::string_view key = token.substr(0, bracket);
+            if (type(current) != TapeType::Object) {
+                return std::nullopt;
+            }
+            size_t member = current + 1;
+            size_t stop = node(current).payload;
+            bool found = false;
+            while (member < stop) {
+                if (type(member) != TapeType::Key || member + 1 >= stop) {
+                    return std::nullopt;
+                }
+                if (text(member) == key) {
+                    current = member + 1;
+                    found = true;
+                    break;
+                }
+                member = next(member + 1);  // skip the key and its whole value
+            }
+            if (!found) {
+                return std::nullopt;
+            }
+            if (bracket != std::string_view::npos) {
+                size_t index = 0;
+                if (!parseArrayIndex(token.substr(bracket), index) || type(current) != TapeType::Array || index >= node(current).length) {
+                    return std::nullopt;
+                }
+                size_t element = current + 1;
+                size_t elementsEnd = node(current).payload;
+                for (size_t i = 0; i < index && element < elementsEnd; ++i) {
+                    element = next(element);
+                }
+                if (element >= elementsEnd) {
+                    return std::nullopt;
+                }
+                current = element;
+            }
+            if (end == std::string_view::npos) {
+                return current;
+            }
+            start = end + 1;
+        }
+    }
+};
+
+// Function to flatten a JSONValue into tape nodes, depth first.
+inline void appendTape(const JSONValue& value, CacheWriter& writer, std::vector<TapeNode>& nodes) {
+    if (value.isObject() || value.isArray()) {
+        size_t self = nodes.size();
+        nodes.push_back({static_cast<uint32_t>(value.isObject() ? TapeType::Object : TapeType::Array), 0, 0});
+        uint32_t children = 0;
+        if (value.isObject()) {
+            for (const auto& member : value.getObject()) {
+                nodes.push_back({static_cast<uint32_t>(TapeType::Key), static_cast<uint32_t>(member.first.size()), writer.intern(member.first)});
+                appendTape(member.second, writer, nodes);
+                ++children;
+            }
+        } else {
+            for (const auto& element : value.getArray()) {
+                appendTape(element, writer, nodes);
+                ++children;
+            }
+        }
+        nodes[self].length = children;
+        nodes[self].payload = nodes.size();
+    } else if (std::holds_alternative<std::string>(value.value)) {
+        const std::string& text = std::get<std::string>(value.value);
+        nodes.push_back({static_cast<uint32_t>(TapeType::String), static_cast<uint32_t>(text.size()), writer.intern(text)});
+    } else {
+        std::string text = std::to_string(value);
+        nodes.push_back({static_cast<uint32_t>(TapeType::Literal), static_cast<uint32_t>(text.size()), writer.intern(text)});
+    }
+}
+
+// Function to write the tape of a document parsed from sourcePath.
+inline void writeTapeCache(const std::string& cachePath, const std::string& sourcePath, const JSONValue& document) {
+    CacheWriter writer;
+    std::vector<TapeNode> nodes;
+    appendTape(document, writer, nodes);
+    writer.write(cachePath, CacheKind::Tape, sourcePath, nodes, std::vector<uint64_t>{});
+}
+
+// Define the MappedPlan and MappedTape classes: a mapping plus its view, kept together.
+class MappedPlan {
+private:
+    MappedFile file;
+    PlanView planView;
+
+public:
+    MappedPlan(const std::string& cachePath, const std::string& sourcePath) : file(cachePath) {
+        const CacheHeader* header = validateCache(file, CacheKind::Plan, sourcePath, sizeof(PlanEntry), sizeof(PlanStep));
+        if (header == nullptr) {
+            throw std::runtime_error("Stale plan cache " + cachePath);
+        }
+        planView = PlanView(file.bytes(), header);
+    }
+
+    const PlanView& view() const {
+        return planView;
+    }
+};
+
+class MappedTape {
+private:
+    MappedFile file;
+    TapeView tapeView;
+
+public:
+    MappedTape(const std::string& cachePath, const std::string& sourcePath) : file(cachePath) {
+        const CacheHeader* header = validateCache(file, CacheKind::Tape, sourcePath, sizeof(TapeNode), sizeof(uint64_t));
+        if (header == nullptr) {
+            throw std::runtime_error("Stale document tape " + cachePath);
+        }
+        tapeView = TapeView(file.bytes(), header);
+    }
+
+    const TapeView& view() const {
+        return tapeView;
+    }
+};
+
+#endif // TAPE_CACHE_H
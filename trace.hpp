@@ -0,0 +1,330 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "json_text.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Sampled tracing spans, exported in the Chrome trace event format (chrome://tracing, Perfetto).
+// A record handed from thread to thread (pipeline stages, fan-out workers) is sampled once, at
+// ingest, by Tracer::beginRecord(); the TraceRecord travels with it and each thread working on
+// it opens a TraceRecordScope, so all its spans on every thread are kept or dropped together
+// and carry its id. Outside a record scope the decision is taken once per outermost span on
+// the thread. Spans are buffered per thread; the only shared state touched on the recording
+// path is the thread's own buffer. With sampling off (the default) a span costs one relaxed
+// atomic load.
+
+// The tracing identity of one record: id 0 means tracing was off when it was ingested.
+struct TraceRecord {
+    uint64_t id = 0;
+    bool sampled = false;
+};
+
+// Define the Tracer class: the sampling rate and the per-thread span buffers.
+class Tracer {
+public:
+    struct Event {
+        const char* name;       // string literals only; not copied
+        const char* category;
+        int64_t startNs;
+        int64_t durationNs;
+        std::string detail;     // optional, e.g. the service an adapter call went to
+        uint64_t recordId;      // 0 outside a record scope
+    };
+
+    static constexpr size_t kMaxEventsPerThread = 1 << 18;
+
+private:
+    struct ThreadBuffer {
+        std::mutex mutex;
+        std::vector<Event> events;
+        std::string threadName;
+        uint32_t tid = 0;
+        uint64_t dropped = 0;
+    };
+
+    struct ThreadState {
+        std::shared_ptr<ThreadBuffer> buffer;
+        std::string threadName;
+        uint32_t depth = 0;
+        uint64_t roots = 0;
+        bool sampled = false;
+        TraceRecord record;     // the record this thread is working on, if any
+    };
+
+    // Record one record (or outermost span) in every samplePeriod; 0 disables tracing.
+    static inline std::atomic<uint32_t> samplePeriod{0};
+    static inline std::atomic<uint64_t> recordsSeen{0};
+    static inline std::mutex registryMutex;
+    static inline std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+    static inline const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+
+    static ThreadState& threadState() {
+        thread_local ThreadState state;
+        return state;
+    }
+
+    static ThreadBuffer& bufferFor(ThreadState& state) {
+        if (!state.buffer) {
+            state.buffer = std::make_shared<ThreadBuffer>();
+            state.buffer->threadName = state.threadName;
+            std::lock_guard<std::mutex> lock(registryMutex);
+            state.buffer->tid = static_cast<uint32_t>(buffers.size() + 1);
+            buffers.push_back(state.buffer);
+        }
+        return *state.buffer;
+    }
+
+    static void writeMicros(std::ostream& out, int64_t nanos) {
+        out << nanos / 1000 << '.';
+        int64_t fraction = nanos % 1000;
+        out << static_cast<char>('0' + fraction / 100) << static_cast<char>('0' + fraction / 10 % 10) << static_cast<char>('0' + fraction % 10);
+    }
+
+public:
+    static bool active() {
+        return samplePeriod.load(std::memory_order_relaxed) != 0;
+    }
+
+    // Fraction of records to trace: 0 turns tracing off, 1 traces every record, 0.01 one in a
+    // hundred. Takes effect for the next record ingested and the next outermost span elsewhere.
+    static void setSampleRate(double fraction) {
+        uint32_t period = 0;
+        if (fraction > 0) {
+            period = fraction >= 1 ? 1 : static_cast<uint32_t>(std::lround(1 / fraction));
+        }
+        samplePeriod.store(period, std::memory_order_relaxed);
+    }
+
+    static double sampleRate() {
+        uint32_t period = samplePeriod.load(std::memory_order_relaxed);
+        return period == 0 ? 0.0 : 1.0 / period;
+    }
+
+    // Label the calling thread in the exported trace.
+    static void setThreadName(std::string name) {
+        ThreadState& state = threadState();
+        state.threadName = std::move(name);
+        if (state.buffer) {
+            std::lock_guard<std::mutex> lock(state.buffer->mutex);
+            state.buffer->threadName = state.threadName;
+        }
+    }
+
+    // Give a new record its id and sampling decision; call once, where the record enters.
+    static TraceRecord beginRecord() {
+        uint32_t period = samplePeriod.load(std::memory_order_relaxed);
+        if (period == 0) {
+            return {};
+        }
+        uint64_t id = recordsSeen.fetch_add(1, std::memory_order_relaxed) + 1;
+        return {id, (id - 1) % period == 0};
+    }
+
+    // The record the calling thread is working on, to hand to threads it passes work to.
+    static TraceRecord currentRecord() {
+        return threadState().record;
+    }
+
+    // Used by TraceRecordScope; returns the record that was current before.
+    static TraceRecord exchangeRecord(TraceRecord record) {
+        ThreadState& state = threadState();
+        TraceRecord previous = state.record;
+        state.record = record;
+        return previous;
+    }
+
+    // Called by TraceSpan. Returns whether the span being opened is recorded.
+    static bool enter() {
+        ThreadState& state = threadState();
+        if (state.depth++ == 0) {
+            if (state.record.id != 0) {
+                state.sampled = state.record.sampled;
+            } else {
+                uint32_t period = samplePeriod.load(std::memory_order_relaxed);
+                state.sampled = period != 0 && state.roots++ % period == 0;
+            }
+        }
+        return state.sampled;
+    }
+
+    static void leave(bool recorded, const char* name, const char* category, int64_t startNs, std::string_view detail) {
+        ThreadState& state = threadState();
+        --state.depth;
+        if (!recorded) {
+            return;
+        }
+        int64_t endNs = now();
+        ThreadBuffer& buffer = bufferFor(state);
+        std::lock_guard<std::mutex> lock(buffer.mutex);
+        if (buffer.events.size() >= kMaxEventsPerThread) {
+            ++buffer.dropped;
+            return;
+        }
+        buffer.events.push_back({name, category, startNs, endNs - startNs, std::string(detail), state.record.id});
+    }
+
+    static int64_t now() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+    }
+
+    // Spans recorded so far, and those lost because a thread's buffer was full.
+    static size_t eventCount() {
+        size_t count = 0;
+        std::lock_guard<std::mutex> lock(registryMutex);
+        for (const auto& buffer : buffers) {
+            std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+            count += buffer->events.size();
+        }
+        return count;
+    }
+
+    static uint64_t droppedCount() {
+        uint64_t dropped = 0;
+        std::lock_guard<std::mutex> lock(registryMutex);
+        for (const auto& buffer : buffers) {
+            std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+            dropped += buffer->dropped;
+        }
+        return dropped;
+    }
+
+    // Discard everything recorded so far; threads keep their buffers and names.
+    static void clear() {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        for (const auto& buffer : buffers) {
+            std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+            buffer->events.clear();
+            buffer->dropped = 0;
+        }
+    }
+
+    // Function to write every recorded span as a Chrome trace JSON object. Spans are complete
+    // ("X") events in microseconds; each thread that recorded anything gets its own track.
+    // Spans of a record carry its id in args.record, to follow it across threads.
+    static void writeChromeTrace(std::ostream& out) {
+        out << "{\"traceEvents\":[";
+        bool first = true;
+        auto separator = [&]() {
+            if (!first) {
+                out << ",\n";
+            }
+            first = false;
+        };
+        std::lock_guard<std::mutex> lock(registryMutex);
+        for (const auto& buffer : buffers) {
+            std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+            separator();
+            out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->tid << ",\"args\":{\"name\":\"";
+            writeEscapedJson(out, buffer->threadName.empty() ? "thread " + std::to_string(buffer->tid) : buffer->threadName);
+            out << "\"}}";
+            for (const Event& event : buffer->events) {
+                separator();
+                out << "{\"name\":\"";
+                writeEscapedJson(out, event.name);
+                out << "\",\"cat\":\"";
+                writeEscapedJson(out, event.category);
+                out << "\",\"ph\":\"X\",\"ts\":";
+                writeMicros(out, event.startNs);
+                out << ",\"dur\":";
+                writeMicros(out, event.durationNs);
+                out << ",\"pid\":1,\"tid\":" << buffer->tid;
+                if (event.recordId != 0 || !event.detail.empty()) {
+                    out << ",\"args\":{";
+                    if (event.recordId != 0) {
+                        out << "\"record\":" << event.recordId << (event.detail.empty() ? "" : ",");
+                    }
+                    if (!event.detail.empty()) {
+                        out << "\"detail\":\"";
+                        writeEscapedJson(out, event.detail);
+                        out << "\"";
+                    }
+                    out << "}";
+                }
+                out << "}";
+            }
+        }
+        out << "],\"displayTimeUnit\":\"ns\"}\n";
+    }
+
+    static bool writeChromeTrace(const std::string& path) {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        if (!file) {
+            return false;
+        }
+        writeChromeTrace(file);
+        return static_cast<bool>(file);
+    }
+};
+
+// Define the TraceSpan class: records the lifetime of a scope as one span when its record is
+// sampled. name and category must be string literals; detail is copied only when recorded.
+class TraceSpan {
+private:
+    const char* name;
+    const char* category;
+    std::string_view detail;
+    int64_t startNs = 0;
+    bool entered = false;
+    bool recorded = false;
+
+public:
+    explicit TraceSpan(const char* name, const char* category = "transform", std::string_view detail = {})
+        : name(name), category(category), detail(detail) {
+        if (!Tracer::active()) {
+            return;
+        }
+        entered = true;
+        recorded = Tracer::enter();
+        if (recorded) {
+            startNs = Tracer::now();
+        }
+    }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+    ~TraceSpan() {
+        if (entered) {
+            Tracer::leave(recorded, name, category, startNs, detail);
+        }
+    }
+};
+
+// Define the TraceRecordScope class: makes a record current on the calling thread for the
+// lifetime of a scope, so the spans opened there follow its sampling decision and carry its id.
+// Does nothing for a record ingested with tracing off.
+class TraceRecordScope {
+private:
+    TraceRecord previous;
+    bool entered = false;
+
+public:
+    explicit TraceRecordScope(TraceRecord record) {
+        if (record.id != 0) {
+            entered = true;
+            previous = Tracer::exchangeRecord(record);
+        }
+    }
+
+    TraceRecordScope(const TraceRecordScope&) = delete;
+    TraceRecordScope& operator=(const TraceRecordScope&) = delete;
+
+    ~TraceRecordScope() {
+        if (entered) {
+            Tracer::exchangeRecord(previous);
+        }
+    }
+};
+
+#endif // TRACE_H
@@ -900,10 +900,36 @@ int main() {
 
     return 0;
 }*/#include "json_pack.hpp"
+#include "operation_factory.hpp"
+#include "pipeline.hpp"
+#include "expected.hpp"
+#include "dedup_cache.hpp"
+#include "chunked_reader.hpp"
+#include "tape_cache.hpp"
+#include "numa_placement.hpp"
+#include "trace.hpp"
+#include "uring_io.hpp"
+#include "json_text.hpp"
 #include <string>
+#include <string_view>
+#include <charconv>
+#include <cstring>
+#include <type_traits>
 #include <unordered_map>
 #include <iostream>
+#include <sstream>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <algorithm>
+#include <exception>
+#include <variant>
 JSONValue resolveExpression(const JSONValue& input, const std::string& expression) {
+    TraceSpan span("resolveExpression", "template", expression);
     std::string result = expression;
     size_t pos = 0;
     while ((pos = result.find("${", pos)) != std::string::npos) {
@@ -1059,6 +1085,68 @@ JSONValue extractValue(const JSONValue& data, const std::string& path) {
     return *current;
 }
 
+// Non-throwing counterpart of parseArrayToken: "key[index]" -> (key, index).
+Expected<std::pair<std::string_view, size_t>> tryParseArrayToken(std::string_view token) {
+    size_t startPos = token.find('[');
+    size_t endPos = token.find(']');
+    if (startPos == std::string_view::npos || endPos == std::string_view::npos || endPos <= startPos + 1) {
+        return Error(ErrorCode::InvalidArrayToken, token);
+    }
+    size_t index = 0;
+    auto parsed = std::from_chars(token.data() + startPos + 1, token.data() + endPos, index);
+    if (parsed.ec != std::errc() || parsed.ptr != token.data() + endPos) {
+        return Error(ErrorCode::InvalidArrayToken, token);
+    }
+    return std::make_pair(token.substr(0, startPos), index);
+}
+
+// Non-throwing counterpart of extractValue. Returns a pointer into data, so a hit copies nothing
+// and a miss allocates nothing; Error::message() formats the text only if someone asks.
+Expected<const JSONValue*> tryExtractValue(const JSONValue& data, std::string_view path) {
+    const JSONValue* current = &data;
+    size_t start = 0;
+    for (;;) {
+        size_t end = path.find('.', start);
+        std::string_view token = path.substr(start, end == std::string_view::npos ? std::string_view::npos : end - start);
+        std::string_view key = token;
+        size_t index = 0;
+        bool hasIndex = token.find('[') != std::string_view::npos;
+        if (hasIndex) {
+            auto arrayToken = tryParseArrayToken(token);
+            if (!arrayToken) {
+                return arrayToken.error();
+            }
+            key = (*arrayToken).first;
+            index = (*arrayToken).second;
+        }
+
+        if (!current->isObject()) {
+            return Error(ErrorCode::NotAnObject, key);
+        }
+        const auto& object = current->getObject();
+        auto it = object.find(std::string(key));
+        if (it == object.end()) {
+            return Error(ErrorCode::KeyNotFound, key);
+        }
+        current = &it->second;
+
+        if (hasIndex) {
+            if (!current->isArray()) {
+                return Error(ErrorCode::NotAnArray, key);
+            }
+            if (index >= current->getArray().size()) {
+                return Error(ErrorCode::IndexOutOfBounds, key, index);
+            }
+            current = &current->getArray()[index];
+        }
+
+        if (end == std::string_view::npos) {
+            return current;
+        }
+        start = end + 1;
+    }
+}
+
 // Split a string by a delimiter
 std::vector<std::string> split(const std::string& s, char delimiter) {
     std::vector<std::string> tokens;
@@ -1070,8 +1158,62 @@ std::vector<std::string> split(const std::string& s, char delimiter) {
     return tokens;
 }
 
+// Function to walk a JSON array up to the given index
+bool advanceToArrayIndex(JsonPack& pack, size_t arrayIndex) {
+    if (pack.ValueType() == JSON_ARRAY) {
+        for (size_t j = 0; j <= arrayIndex; ++j) {
+            if (!pack.ReadValue()) return false;
+            if (j < arrayIndex) pack.ReadValue();
+        }
+    }
+    return true;
+}
+
+// Function to render the current value as text. Strings are unescaped and checked to be valid
+// UTF-8 (see tryDecodeJsonString); a malformed one comes back as InvalidUtf8, InvalidEscape or
+// ControlCharacter.
+Expected<std::string> tryPackValueToString(JsonPack& pack) {
+    // Extract the value based on its type
+    switch (pack.ValueType()) {
+        case JSON_STRING:
+            return tryDecodeJsonString(std::string_view(pack.Value(), pack.ValueLength()));
+        case JSON_INTEGER:
+            return std::to_string(pack.Quantity());
+        case JSON_DECIMAL:
+            return std::to_string(pack.Number());
+        case JSON_BOOLEAN:
+            return std::string(pack.Flag() ? "true" : "false");
+        case JSON_NULL:
+            return std::string("null");
+        default:
+            return std::string();
+    }
+}
+
+// Like tryPackValueToString, but a malformed string throws std::runtime_error.
+std::string packValueToString(JsonPack& pack) {
+    return tryPackValueToString(pack).value();
+}
+
+// Function to open a record for reading. JsonPack parses lazily, so this span covers only
+// reaching the top-level object; the rest of the parse is charged to the lookups that need it.
+bool openRecord(JsonPack& pack) {
+    TraceSpan span("JsonPack parse", "parse");
+    return pack.ReadObject();
+}
+
+// Function to write one output member, "name": "value", escaping both as JSON strings.
+void writeField(std::ostream& output, std::string_view name, std::string_view value) {
+    output << "\"";
+    writeEscapedJson(output, name);
+    output << "\": \"";
+    writeEscapedJson(output, value);
+    output << "\"";
+}
+
 // Function to evaluate JSON path
 std::string evaluateJSONPath(JsonPack& jsonPack, const std::string& path) {
+    TraceSpan span("evaluateJSONPath", "lookup", path);
     std::vector<std::string> tokens = split(path, '.');
     JsonPack* currentPack = &jsonPack;
 
@@ -1099,54 +1241,780 @@ std::string evaluateJSONPath(JsonPack& jsonPack, const std::string& path) {
         }
 
         // If array index exists, traverse the array
+        if (arrayIndex != std::string::npos && !advanceToArrayIndex(*currentPack, arrayIndex)) {
+            return ""; // Array index out of bounds
+        }
+    }
+
+    return packValueToString(*currentPack);
+}
+
+// Define the ShapeCache class.
+// Records in one feed almost always share key order and layout, so for each mapped path we
+// remember which member (ordinal) matched at every step and where its key sat in the previous
+// record. The next record checks those bytes first; if they still hold the key, the member at
+// the remembered ordinal is accepted when its key starts at the remembered offset, a single
+// pointer comparison. Members passed on the way are still compared by raw key bytes (never
+// building a std::string), so a key that moved is found wherever it now sits and re-learned.
+// One ShapeCache belongs to one mapping on one feed and is not thread-safe.
+class ShapeCache {
+public:
+    struct Step {
+        std::string key;
+        size_t arrayIndex = std::string::npos;
+        long ordinal = -1;        // member position within its object in the previous record
+        ptrdiff_t keyOffset = -1; // byte offset of the key in the previous record
+    };
+
+    struct Stats {
+        uint64_t lookups = 0;
+        uint64_t hits = 0;        // every step of the path matched the cached shape
+        uint64_t misses = 0;      // at least one step fell back to a full scan
+
+        double hitRate() const {
+            return lookups == 0 ? 0.0 : static_cast<double>(hits) / lookups;
+        }
+    };
+
+private:
+    // Compiled once per mapping, in the mapping's iteration order.
+    std::vector<std::vector<Step>> shapes;
+    const std::unordered_map<std::string, std::string>* mapping = nullptr;
+    uint64_t mappingFingerprint = 0;
+    Stats stats;
+    std::vector<std::string> values;  // the record being transformed, reused across records
+
+    static bool keyEquals(JsonPack& pack, const std::string& key) {
+        return static_cast<size_t>(pack.KeyLength()) == key.size() && std::memcmp(pack.Key(), key.data(), key.size()) == 0;
+    }
+
+    static bool keyStillAt(const char* base, int length, const Step& step) {
+        if (step.keyOffset < 0 || step.keyOffset + static_cast<ptrdiff_t>(step.key.size()) >= length) {
+            return false;
+        }
+        return std::memcmp(base + step.keyOffset, step.key.data(), step.key.size()) == 0 &&
+               base[step.keyOffset + step.key.size()] == '"';
+    }
+
+    // Hash of every key and path in iteration order: shapes are indexed by that order, so a
+    // mapping edited in place, or rehashed into a new order, no longer matches.
+    static uint64_t fingerprint(const std::unordered_map<std::string, std::string>& candidate) {
+        uint64_t hash = candidate.size();
+        for (const auto& pair : candidate) {
+            hash = (hash ^ std::hash<std::string>()(pair.first)) * 0x100000001b3ULL;
+            hash = (hash ^ std::hash<std::string>()(pair.second)) * 0x100000001b3ULL;
+        }
+        return hash;
+    }
+
+    // Position the pack on step's member; returns false if the member is absent.
+    static bool findMember(JsonPack& pack, const char* base, int length, Step& step, bool& usedCache) {
+        // The key's bytes may still be at the old offset while the member has moved (keys
+        // reordered, an earlier value grew), so the offset alone is never trusted.
+        long cachedOrdinal = step.ordinal >= 0 && keyStillAt(base, length, step) ? step.ordinal : -1;
+        long ordinal = 0;
+        while (pack.ReadMember()) {
+            if (ordinal == cachedOrdinal && pack.Key() - base == step.keyOffset &&
+                static_cast<size_t>(pack.KeyLength()) == step.key.size()) {
+                usedCache = true;
+                return true;
+            }
+            if (keyEquals(pack, step.key)) {
+                step.ordinal = ordinal;
+                step.keyOffset = pack.Key() - base;
+                return true;
+            }
+            ++ordinal;
+        }
+        step.ordinal = -1;
+        return false;
+    }
+
+public:
+    void compile(const std::unordered_map<std::string, std::string>& newMapping) {
+        mapping = &newMapping;
+        mappingFingerprint = fingerprint(newMapping);
+        shapes.clear();
+        for (const auto& pair : newMapping) {
+            std::vector<Step> steps;
+            for (std::string& token : split(pair.second, '.')) {
+                Step step;
+                size_t arrayIndexPos = token.find('[');
+                if (arrayIndexPos != std::string::npos) {
+                    step.arrayIndex = std::stoul(token.substr(arrayIndexPos + 1, token.find(']') - arrayIndexPos - 1));
+                    token.resize(arrayIndexPos);
+                }
+                step.key = std::move(token);
+                steps.push_back(std::move(step));
+            }
+            shapes.push_back(std::move(steps));
+        }
+    }
+
+    // True if compile() saw this mapping with the same contents in the same order.
+    bool compiledFor(const std::unordered_map<std::string, std::string>& candidate) const {
+        return mapping == &candidate && shapes.size() == candidate.size() && mappingFingerprint == fingerprint(candidate);
+    }
+
+    // Same result as evaluateJSONPath for the index-th path of the compiled mapping, except
+    // that a malformed string value is returned as an Error rather than thrown.
+    Expected<std::string> evaluate(JsonPack& pack, const char* base, int length, size_t index) {
+        TraceSpan span("evaluateJSONPath", "lookup");
+        bool allCached = true;
+        ++stats.lookups;
+        for (Step& step : shapes[index]) {
+            if (pack.ReadObject()) {
+                bool usedCache = false;
+                if (!findMember(pack, base, length, step, usedCache)) {
+                    ++stats.misses;
+                    return std::string();
+                }
+                allCached = allCached && usedCache;
+            }
+            if (step.arrayIndex != std::string::npos && !advanceToArrayIndex(pack, step.arrayIndex)) {
+                ++stats.misses;
+                return std::string();
+            }
+        }
+        ++(allCached ? stats.hits : stats.misses);
+        return tryPackValueToString(pack);
+    }
+
+    // Scratch for the values of one record, so nothing is written until all are known good.
+    std::vector<std::string>& recordValues() {
+        return values;
+    }
+
+    const Stats& statistics() const {
+        return stats;
+    }
+
+    void report(const std::string& feed, std::ostream& out) const {
+        out << "shape cache " << feed << ": " << stats.lookups << " lookups, " << stats.hits << " hits, "
+            << stats.misses << " misses, hit rate " << stats.hitRate() * 100 << "%" << std::endl;
+    }
+};
+
+// A path compiled to (key, array index) steps; the index is npos when a token has none.
+using PathSteps = std::vector<std::pair<std::string, size_t>>;
+
+// Function to compile a dotted path such as "a.b[2].c" into steps
+Expected<PathSteps> tryCompilePath(std::string_view path) {
+    PathSteps steps;
+    size_t start = 0;
+    for (;;) {
+        size_t end = path.find('.', start);
+        std::string_view token = path.substr(start, end == std::string_view::npos ? std::string_view::npos : end - start);
+        size_t arrayIndex = std::string::npos;
+        if (token.find('[') != std::string_view::npos) {
+            auto parsed = tryParseArrayToken(token);
+            if (!parsed) {
+                return parsed.error();
+            }
+            token = (*parsed).first;
+            arrayIndex = (*parsed).second;
+        }
+        if (token.empty()) {
+            return Error(ErrorCode::InvalidPath, path);
+        }
+        steps.emplace_back(std::string(token), arrayIndex);
+        if (end == std::string_view::npos) {
+            return steps;
+        }
+        start = end + 1;
+    }
+}
+
+// Function to position the pack on the value at steps, comparing raw key bytes
+bool seekPath(JsonPack& pack, const PathSteps& steps) {
+    for (const auto& [key, arrayIndex] : steps) {
+        if (pack.ReadObject()) {
+            bool found = false;
+            while (pack.ReadMember()) {
+                if (static_cast<size_t>(pack.KeyLength()) == key.size() && std::memcmp(pack.Key(), key.data(), key.size()) == 0) {
+                    found = true;
+                    break;
+                }
+            }
+            if (!found) {
+                return false;
+            }
+        }
+        if (arrayIndex != std::string::npos && !advanceToArrayIndex(pack, arrayIndex)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Define the CompiledTemplate class: a resolveExpression template split once into literal text
+// and "${path}" placeholders. Each distinct path is compiled to steps and becomes one column;
+// a placeholder that appears twice reads the same column. An unterminated "${" is literal text,
+// as in resolveExpression.
+class CompiledTemplate {
+private:
+    std::vector<std::string> literals;   // literals[k] precedes placeholder k; one extra at the end
+    std::vector<size_t> placeholderColumns;
+    std::vector<PathSteps> columnPaths;
+    std::vector<std::string> columnNames;
+
+public:
+    static CompiledTemplate compile(std::string_view expression) {
+        CompiledTemplate compiled;
+        std::string literal;
+        size_t pos = 0;
+        for (;;) {
+            size_t open = expression.find("${", pos);
+            size_t close = open == std::string_view::npos ? std::string_view::npos : expression.find('}', open);
+            if (close == std::string_view::npos) {
+                literal.append(expression.substr(pos));
+                break;
+            }
+            literal.append(expression.substr(pos, open - pos));
+            compiled.literals.push_back(std::move(literal));
+            literal.clear();
+
+            std::string_view path = expression.substr(open + 2, close - open - 2);
+            auto column = std::find(compiled.columnNames.begin(), compiled.columnNames.end(), path);
+            if (column == compiled.columnNames.end()) {
+                auto steps = tryCompilePath(path);
+                if (!steps) {
+                    throw std::invalid_argument("Invalid placeholder path in template: " + steps.error().message());
+                }
+                compiled.columnNames.emplace_back(path);
+                compiled.columnPaths.push_back(std::move(*steps));
+                column = compiled.columnNames.end() - 1;
+            }
+            compiled.placeholderColumns.push_back(static_cast<size_t>(column - compiled.columnNames.begin()));
+            pos = close + 1;
+        }
+        compiled.literals.push_back(std::move(literal));
+        return compiled;
+    }
+
+    size_t placeholderCount() const {
+        return placeholderColumns.size();
+    }
+
+    size_t columnCount() const {
+        return columnPaths.size();
+    }
+
+    const std::string& literal(size_t index) const {
+        return literals[index];
+    }
+
+    size_t columnOf(size_t placeholder) const {
+        return placeholderColumns[placeholder];
+    }
+
+    const PathSteps& columnPath(size_t column) const {
+        return columnPaths[column];
+    }
+
+    const std::string& columnName(size_t column) const {
+        return columnNames[column];
+    }
+};
+
+// Define the RenderedBatch class: the outputs of one template over a batch of records, stored
+// back to back in one buffer. Record i is buffer[offsets[i], offsets[i + 1]). Reusing one
+// RenderedBatch across batches keeps its buffers, and renderBatch's scratch, allocated.
+struct RenderedBatch {
+    // A resolved placeholder value: a string referenced in place, or (data == nullptr) bytes
+    // [offset, offset + length) of formatted.
+    struct Cell {
+        const char* data;
+        size_t offset;
+        size_t length;
+    };
+
+    std::string buffer;
+    std::vector<size_t> offsets;
+    uint64_t missing = 0;  // placeholders whose path was absent in their record (rendered empty)
+    std::vector<Cell> cells;   // scratch, column-major: cells[column * count + record]
+    std::string formatted;     // scratch: the text of non-string values
+
+    size_t size() const {
+        return offsets.empty() ? 0 : offsets.size() - 1;
+    }
+
+    std::string_view operator[](size_t index) const {
+        return std::string_view(buffer).substr(offsets[index], offsets[index + 1] - offsets[index]);
+    }
+};
+
+// Function to follow compiled path steps through a JSONValue. Returns nullptr if any step is missing.
+const JSONValue* findCompiledPath(const JSONValue& record, const PathSteps& steps) {
+    const JSONValue* current = &record;
+    for (const auto& [key, arrayIndex] : steps) {
+        if (!current->isObject()) {
+            return nullptr;
+        }
+        const auto& object = current->getObject();
+        auto it = object.find(key);
+        if (it == object.end()) {
+            return nullptr;
+        }
+        current = &it->second;
         if (arrayIndex != std::string::npos) {
-            if (currentPack->ValueType() == JSON_ARRAY) {
-                for (size_t j = 0; j <= arrayIndex; ++j) {
-                    if (!currentPack->ReadValue()) return ""; // Array index out of bounds
-                    if (j < arrayIndex) currentPack->ReadValue();
+            if (!current->isArray() || arrayIndex >= current->getArray().size()) {
+                return nullptr;
+            }
+            current = &current->getArray()[arrayIndex];
+        }
+    }
+    return current;
+}
+
+// Function to render one template over a batch of records: the batch counterpart of calling
+// resolveExpression per record. Each column is resolved over the whole batch in turn (one
+// path, all records), keeping the path and its keys hot; string values are referenced in place
+// and only other types are formatted, into one reused buffer. The outputs are then sized
+// exactly and copied into out.buffer in a single pass. A missing path renders as an empty string.
+void renderBatch(const CompiledTemplate& compiled, const JSONValue* records, size_t count, RenderedBatch& out) {
+    TraceSpan span("renderBatch", "template");
+    using Cell = RenderedBatch::Cell;
+    size_t columns = compiled.columnCount();
+    std::vector<Cell>& cells = out.cells;
+    cells.resize(columns * count);
+    out.formatted.clear();
+    out.missing = 0;
+
+    bool anyFormatted = false;
+    for (size_t column = 0; column < columns; ++column) {
+        const PathSteps& steps = compiled.columnPath(column);
+        Cell* columnCells = cells.data() + column * count;
+        for (size_t r = 0; r < count; ++r) {
+            const JSONValue* value = findCompiledPath(records[r], steps);
+            if (value == nullptr) {
+                columnCells[r] = {"", 0, 0};
+                ++out.missing;
+            } else if (const std::string* text = std::get_if<std::string>(&value->value)) {
+                columnCells[r] = {text->data(), 0, text->size()};
+            } else {
+                size_t offset = out.formatted.size();
+                out.formatted += std::to_string(*value);
+                columnCells[r] = {nullptr, offset, out.formatted.size() - offset};
+                anyFormatted = true;
+            }
+        }
+    }
+    // formatted has stopped growing, so its bytes can now be referenced in place as well.
+    if (anyFormatted) {
+        for (Cell& cell : cells) {
+            if (cell.data == nullptr) {
+                cell.data = out.formatted.data() + cell.offset;
+            }
+        }
+    }
+
+    size_t literalBytes = 0;
+    for (size_t k = 0; k <= compiled.placeholderCount(); ++k) {
+        literalBytes += compiled.literal(k).size();
+    }
+    out.offsets.resize(count + 1);
+    size_t total = 0;
+    for (size_t r = 0; r < count; ++r) {
+        out.offsets[r] = total;
+        total += literalBytes;
+        for (size_t k = 0; k < compiled.placeholderCount(); ++k) {
+            total += cells[compiled.columnOf(k) * count + r].length;
+        }
+    }
+    out.offsets[count] = total;
+
+    out.buffer.resize(total);
+    char* cursor = out.buffer.data();
+    for (size_t r = 0; r < count; ++r) {
+        for (size_t k = 0; k < compiled.placeholderCount(); ++k) {
+            const std::string& literal = compiled.literal(k);
+            std::memcpy(cursor, literal.data(), literal.size());
+            cursor += literal.size();
+            const Cell& cell = cells[compiled.columnOf(k) * count + r];
+            std::memcpy(cursor, cell.data, cell.length);
+            cursor += cell.length;
+        }
+        const std::string& tail = compiled.literal(compiled.placeholderCount());
+        std::memcpy(cursor, tail.data(), tail.size());
+        cursor += tail.size();
+    }
+}
+
+RenderedBatch renderBatch(const CompiledTemplate& compiled, const std::vector<JSONValue>& records) {
+    RenderedBatch out;
+    renderBatch(compiled, records.data(), records.size(), out);
+    return out;
+}
+
+// Define the RecordFilter class.
+// A "$filter" member in a transformation definition holds conditions joined by "&&", each
+// "path op literal": op is one of == != < <= > >=, and literal is a quoted string ('...' or
+// "..."), a number, true, false or null, e.g.  "status == 'ACTIVE' && amount.value > 100".
+// The conditions are compiled once and tested against JsonPack before any output is built.
+// Testing stops at the first failing condition, so the rest of a rejected record is never
+// scanned. Strings are compared as decoded text; only values holding an escape are decoded, the
+// rest are compared in place. A missing field, one of another type than the literal, or a
+// malformed string satisfies only !=. matches() is const and thread-safe.
+class RecordFilter {
+public:
+    enum class Op { Equal, NotEqual, Less, LessEqual, Greater, GreaterEqual };
+    enum class LiteralKind { String, Number, Boolean, Null };
+
+    struct Condition {
+        PathSteps steps;
+        Op op = Op::Equal;
+        LiteralKind kind = LiteralKind::Null;
+        std::string text;
+        double number = 0;
+        bool flag = false;
+    };
+
+private:
+    std::vector<Condition> conditions;
+
+    static std::string_view trim(std::string_view text) {
+        size_t start = text.find_first_not_of(" \t\r\n");
+        if (start == std::string_view::npos) {
+            return {};
+        }
+        return text.substr(start, text.find_last_not_of(" \t\r\n") - start + 1);
+    }
+
+    // Split on separator outside quoted literals.
+    static std::vector<std::string_view> splitOutsideQuotes(std::string_view text, std::string_view separator) {
+        std::vector<std::string_view> parts;
+        char quote = 0;
+        size_t start = 0;
+        for (size_t i = 0; i < text.size(); ++i) {
+            if (quote != 0) {
+                if (text[i] == '\\') {
+                    ++i;
+                } else if (text[i] == quote) {
+                    quote = 0;
                 }
+            } else if (text[i] == '"' || text[i] == '\'') {
+                quote = text[i];
+            } else if (text.compare(i, separator.size(), separator) == 0) {
+                parts.push_back(text.substr(start, i - start));
+                i += separator.size() - 1;
+                start = i + 1;
+            }
+        }
+        parts.push_back(text.substr(start));
+        return parts;
+    }
+
+    static Condition compileCondition(std::string_view clause) {
+        static const std::pair<std::string_view, Op> operators[] = {
+            {"==", Op::Equal}, {"!=", Op::NotEqual}, {"<=", Op::LessEqual}, {">=", Op::GreaterEqual}, {"<", Op::Less}, {">", Op::Greater}};
+        Condition condition;
+        size_t opPos = std::string_view::npos;
+        size_t opLength = 0;
+        for (const auto& candidate : operators) {
+            size_t pos = clause.find(candidate.first);
+            if (pos != std::string_view::npos && pos < opPos) {
+                opPos = pos;
+                opLength = candidate.first.size();
+                condition.op = candidate.second;
             }
         }
+        if (opPos == std::string_view::npos) {
+            throw std::invalid_argument("Invalid filter condition: " + std::string(clause));
+        }
+
+        auto steps = tryCompilePath(trim(clause.substr(0, opPos)));
+        if (!steps) {
+            throw std::invalid_argument("Invalid filter condition: " + std::string(clause));
+        }
+        condition.steps = std::move(*steps);
+
+        std::string_view literal = trim(clause.substr(opPos + opLength));
+        if (literal.size() >= 2 && (literal.front() == '"' || literal.front() == '\'') && literal.back() == literal.front()) {
+            condition.kind = LiteralKind::String;
+            for (size_t i = 1; i + 1 < literal.size(); ++i) {
+                if (literal[i] == '\\' && i + 2 < literal.size()) {
+                    ++i;
+                }
+                condition.text += literal[i];
+            }
+        } else if (literal == "true" || literal == "false") {
+            condition.kind = LiteralKind::Boolean;
+            condition.flag = literal == "true";
+        } else if (literal == "null") {
+            condition.kind = LiteralKind::Null;
+        } else {
+            condition.kind = LiteralKind::Number;
+            auto [end, ec] = std::from_chars(literal.data(), literal.data() + literal.size(), condition.number);
+            if (literal.empty() || ec != std::errc() || end != literal.data() + literal.size()) {
+                throw std::invalid_argument("Invalid filter literal: " + std::string(literal));
+            }
+        }
+        bool ordering = condition.op != Op::Equal && condition.op != Op::NotEqual;
+        if (ordering && (condition.kind == LiteralKind::Boolean || condition.kind == LiteralKind::Null)) {
+            throw std::invalid_argument("Invalid filter condition: " + std::string(clause));
+        }
+        return condition;
+    }
+
+    static bool holds(int comparison, Op op) {
+        switch (op) {
+            case Op::Equal:
+                return comparison == 0;
+            case Op::NotEqual:
+                return comparison != 0;
+            case Op::Less:
+                return comparison < 0;
+            case Op::LessEqual:
+                return comparison <= 0;
+            case Op::Greater:
+                return comparison > 0;
+            case Op::GreaterEqual:
+                return comparison >= 0;
+        }
+        return false;
     }
 
-    // Extract the value based on its type
-    switch (currentPack->ValueType()) {
-        case JSON_STRING:
-            return std::string(currentPack->Value(), currentPack->ValueLength());
-        case JSON_INTEGER:
-            return std::to_string(currentPack->Quantity());
-        case JSON_DECIMAL:
-            return std::to_string(currentPack->Number());
-        case JSON_BOOLEAN:
-            return currentPack->Flag() ? "true" : "false";
-        case JSON_NULL:
-            return "null";
-        default:
-            return "";
+    static int compareNumbers(double value, double literal) {
+        return value < literal ? -1 : (value > literal ? 1 : 0);
     }
+
+    static bool test(JsonPack& pack, const Condition& condition) {
+        if (!seekPath(pack, condition.steps)) {
+            return condition.op == Op::NotEqual;
+        }
+
+        int comparison = 0;
+        switch (pack.ValueType()) {
+            case JSON_STRING: {
+                if (condition.kind != LiteralKind::String) {
+                    return condition.op == Op::NotEqual;
+                }
+                std::string_view raw(pack.Value(), pack.ValueLength());
+                if (raw.find('\\') == std::string_view::npos) {
+                    comparison = raw.compare(condition.text);
+                    break;
+                }
+                auto decoded = tryDecodeJsonString(raw);
+                if (!decoded) {
+                    return condition.op == Op::NotEqual;
+                }
+                comparison = std::string_view(*decoded).compare(condition.text);
+                break;
+            }
+            case JSON_INTEGER:
+            case JSON_DECIMAL:
+                if (condition.kind != LiteralKind::Number) {
+                    return condition.op == Op::NotEqual;
+                }
+                comparison = compareNumbers(pack.ValueType() == JSON_INTEGER ? static_cast<double>(pack.Quantity()) : pack.Number(), condition.number);
+                break;
+            case JSON_BOOLEAN:
+                if (condition.kind != LiteralKind::Boolean) {
+                    return condition.op == Op::NotEqual;
+                }
+                comparison = pack.Flag() == condition.flag ? 0 : 1;
+                break;
+            case JSON_NULL:
+                if (condition.kind != LiteralKind::Null) {
+                    return condition.op == Op::NotEqual;
+                }
+                break;
+            default:
+                return condition.op == Op::NotEqual;
+        }
+        return holds(comparison, condition.op);
+    }
+
+public:
+    // Throws std::invalid_argument for a malformed expression.
+    static RecordFilter compile(std::string_view expression) {
+        RecordFilter filter;
+        if (trim(expression).empty()) {
+            return filter;
+        }
+        for (std::string_view clause : splitOutsideQuotes(expression, "&&")) {
+            filter.conditions.push_back(compileCondition(trim(clause)));
+        }
+        return filter;
+    }
+
+    bool empty() const {
+        return conditions.empty();
+    }
+
+    size_t size() const {
+        return conditions.size();
+    }
+
+    // Test the record the pack is positioned on.
+    bool matches(JsonPack& pack) const {
+        for (const Condition& condition : conditions) {
+            if (!test(pack, condition)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool matches(char* inputData, int inputLen) const {
+        if (conditions.empty()) {
+            return true;
+        }
+        JsonPack pack(inputData, inputLen);
+        return pack.ReadObject() && matches(pack);
+    }
+};
+
+// A transformation definition: the field mapping plus the optional record filter.
+struct TransformationDefinition {
+    std::unordered_map<std::string, std::string> mapping;
+    RecordFilter filter;
+};
+
+// Define the MessageBinding class.
+// Compiles a mapping against a message type's field descriptors: each mapped output field
+// that names a message field gets its source path pre-split, and bind() walks the input
+// JsonPack and stores every value straight into the message member, converted to the
+// member's type. No JSON text is produced in between and the adapter parses nothing.
+// Mapped fields the message does not have are reported by unbound() and otherwise ignored.
+// A missing source value, or one of an incompatible type, leaves the member at its default.
+// String values are decoded (see tryDecodeJsonString); a malformed one fails the bind.
+template <typename Msg>
+class MessageBinding {
+private:
+    struct Binding {
+        PathSteps steps;
+        typename FieldDescriptor<Msg>::Member member;
+    };
+
+    std::vector<Binding> bindings;
+    std::vector<std::string> unboundFields;
+
+    static Expected<bool> assign(JsonPack& pack, Msg& message, const typename FieldDescriptor<Msg>::Member& member) {
+        return std::visit([&](auto field) -> Expected<bool> {
+            using Field = std::decay_t<decltype(message.*field)>;
+            JsonType type = pack.ValueType();
+            if constexpr (std::is_same_v<Field, std::string>) {
+                auto text = tryPackValueToString(pack);
+                if (!text) {
+                    return text.error();
+                }
+                message.*field = std::move(*text);
+            } else if constexpr (std::is_same_v<Field, bool>) {
+                if (type == JSON_BOOLEAN) {
+                    message.*field = pack.Flag();
+                }
+            } else {
+                if (type == JSON_INTEGER) {
+                    message.*field = static_cast<Field>(pack.Quantity());
+                } else if (type == JSON_DECIMAL) {
+                    message.*field = static_cast<Field>(pack.Number());
+                }
+            }
+            return true;
+        }, member);
+    }
+
+public:
+    using Message = Msg;
+
+    explicit MessageBinding(const std::unordered_map<std::string, std::string>& mapping) {
+        for (const auto& pair : mapping) {
+            const FieldDescriptor<Msg>* field = findField<Msg>(pair.first);
+            if (field == nullptr) {
+                unboundFields.push_back(pair.first);
+                continue;
+            }
+            bindings.push_back({tryCompilePath(pair.second).value(), field->member});
+        }
+    }
+
+    const std::vector<std::string>& unbound() const {
+        return unboundFields;
+    }
+
+    // Fill message from one input record; returns false if the record is not an object, and
+    // the Error of the first malformed string value.
+    Expected<bool> bind(char* inputData, int inputLen, Msg& message) const {
+        JsonPack inputPack(inputData, inputLen);
+        if (!inputPack.ReadObject()) {
+            return false;
+        }
+        for (const Binding& binding : bindings) {
+            if (seekPath(inputPack, binding.steps)) {
+                auto assigned = assign(inputPack, message, binding.member);
+                if (!assigned) {
+                    return assigned;
+                }
+            }
+        }
+        return true;
+    }
+};
+
+// Function to bind a record to a typed message and run one operation on it
+template <typename Msg>
+std::string dispatchRecord(const MessageBinding<Msg>& binding, char* inputData, int inputLen, OperationFactory& factory,
+                           const std::string& serviceName, const std::string& operationName, const std::string& url,
+                           const CallContext& context = CallContext{}) {
+    Msg message;
+    auto bound = binding.bind(inputData, inputLen, message);
+    if (!bound) {
+        throw std::invalid_argument(bound.error().message());
+    }
+    if (!*bound) {
+        throw std::invalid_argument("Input record is not a JSON object");
+    }
+    return factory.dispatchTyped(serviceName, operationName, url, message, context);
 }
-// Function to parse the transformation JSON
-std::unordered_map<std::string, std::string> parseTransformationJson(char* transformationData, int len) {
+
+constexpr std::string_view kFilterMember = "$filter";
+
+// Function to parse a transformation definition, compiling its "$filter" member if present.
+// A malformed key or path string comes back as an Error; a malformed filter still throws
+// std::invalid_argument (see RecordFilter::compile).
+Expected<TransformationDefinition> tryParseTransformationDefinition(char* transformationData, int len) {
     JsonPack transPack(transformationData, len);
-    std::unordered_map<std::string, std::string> mapping;
+    TransformationDefinition definition;
 
     if (transPack.ReadObject()) {
         while (transPack.ReadMember()) {
-            std::string key(transPack.Key(), transPack.KeyLength());
-            std::string value(transPack.Value(), transPack.ValueLength());
-            mapping[key] = value;
+            auto key = tryDecodeJsonString(std::string_view(transPack.Key(), transPack.KeyLength()));
+            if (!key) {
+                return key.error();
+            }
+            auto value = tryDecodeJsonString(std::string_view(transPack.Value(), transPack.ValueLength()));
+            if (!value) {
+                return value.error();
+            }
+            if (*key == kFilterMember) {
+                definition.filter = RecordFilter::compile(*value);
+            } else {
+                definition.mapping[std::move(*key)] = std::move(*value);
+            }
         }
     }
 
-    return mapping;
+    return definition;
+}
+
+TransformationDefinition parseTransformationDefinition(char* transformationData, int len) {
+    return tryParseTransformationDefinition(transformationData, len).value();
+}
+
+// Function to parse the transformation JSON (any "$filter" member is not part of the mapping)
+std::unordered_map<std::string, std::string> parseTransformationJson(char* transformationData, int len) {
+    return parseTransformationDefinition(transformationData, len).mapping;
 }
 
 // Function to transform the input JSON based on the mappings
 void transformJson(const std::unordered_map<std::string, std::string>& mapping, char* inputData, int inputLen, std::ostream& output) {
+    TraceSpan span("transformJson");
     JsonPack inputPack(inputData, inputLen);
 
     output << "{";
-    if (inputPack.ReadObject()) {
+    if (openRecord(inputPack)) {
         bool first = true;
         for (const auto& pair : mapping) {
             if (!first) {
@@ -1156,13 +2024,1029 @@ void transformJson(const std::unordered_map<std::string, std::string>& mapping,
 
             std::string value = evaluateJSONPath(inputPack, pair.second);
 
-            output << "\"" << pair.first << "\": \"" << value << "\"";
+            TraceSpan format("format", "output");
+            writeField(output, pair.first, value);
         }
     }
     output << "}";
 }
 
-int main() {
+// Function to transform the input JSON, trying the cached record shape before searching.
+// A filter, if given, is tested on the same pack before any output is written: a rejected
+// record (or, with a filter, one that is not an object) writes nothing and returns false.
+// Every value is extracted before anything is written, so a record with a malformed string
+// writes nothing either and comes back as that value's Error.
+Expected<bool> tryTransformJson(const std::unordered_map<std::string, std::string>& mapping, ShapeCache& shapeCache, char* inputData, int inputLen,
+                                std::ostream& output, const RecordFilter* filter) {
+    if (!shapeCache.compiledFor(mapping)) {
+        shapeCache.compile(mapping);
+    }
+    TraceSpan span("transformJson");
+    JsonPack inputPack(inputData, inputLen);
+
+    bool isObject = openRecord(inputPack);
+    if (filter != nullptr && !filter->empty() && !(isObject && filter->matches(inputPack))) {
+        return false;
+    }
+    std::vector<std::string>& values = shapeCache.recordValues();
+    values.clear();
+    if (isObject) {
+        for (size_t index = 0; index < mapping.size(); ++index) {
+            auto value = shapeCache.evaluate(inputPack, inputData, inputLen, index);
+            if (!value) {
+                return value.error();
+            }
+            values.push_back(std::move(*value));
+        }
+    }
+    output << "{";
+    size_t index = 0;
+    for (const auto& pair : mapping) {
+        if (index == values.size()) {
+            break;
+        }
+        if (index > 0) {
+            output << ",";
+        }
+        TraceSpan format("format", "output");
+        writeField(output, pair.first, values[index++]);
+    }
+    output << "}";
+    return true;
+}
+
+// Like tryTransformJson, but a malformed record throws std::runtime_error.
+bool transformJson(const std::unordered_map<std::string, std::string>& mapping, ShapeCache& shapeCache, char* inputData, int inputLen,
+                   std::ostream& output, const RecordFilter* filter) {
+    return tryTransformJson(mapping, shapeCache, inputData, inputLen, output, filter).value();
+}
+
+void transformJson(const std::unordered_map<std::string, std::string>& mapping, ShapeCache& shapeCache, char* inputData, int inputLen, std::ostream& output) {
+    transformJson(mapping, shapeCache, inputData, inputLen, output, nullptr);
+}
+
+// Function to write the output of a record that could not be transformed, in place of its
+// transformed object: {"$error": "<message>"}. Batch transforms report bad records this way
+// and carry on with the next one.
+void writeRecordError(std::ostream& output, const Error& error) {
+    output << "{\"$error\": \"";
+    writeEscapedJson(output, error.message());
+    output << "\"}";
+}
+
+// Function to transform a record, reusing the output of a byte-identical record seen recently.
+// mappingVersion must change whenever the mapping does.
+void transformJson(const std::unordered_map<std::string, std::string>& mapping, uint64_t mappingVersion, DedupCache& dedupCache,
+                   ShapeCache& shapeCache, char* inputData, int inputLen, std::ostream& output) {
+    uint64_t hash = hashRecord(inputData, static_cast<size_t>(inputLen));
+    if (auto cached = dedupCache.lookup(mappingVersion, hash, static_cast<size_t>(inputLen))) {
+        output << *cached;
+        return;
+    }
+    std::ostringstream transformed;
+    transformJson(mapping, shapeCache, inputData, inputLen, transformed);
+    std::string text = transformed.str();
+    output << text;
+    dedupCache.insert(mappingVersion, hash, static_cast<size_t>(inputLen), std::move(text));
+}
+
+// Function to transform a record only if it passes the definition's filter. A rejected record
+// writes nothing and returns false; the filter stops reading it at the first failing condition.
+bool transformJson(const TransformationDefinition& definition, ShapeCache& shapeCache, char* inputData, int inputLen, std::ostream& output) {
+    return transformJson(definition.mapping, shapeCache, inputData, inputLen, output, &definition.filter);
+}
+
+// Function to transform a record once and send the result to every target concurrently.
+// Returns the combined per-target responses (see combineResponses), or "" if the definition's
+// filter rejected the record.
+std::string fanOutRecord(const TransformationDefinition& definition, ShapeCache& shapeCache, char* inputData, int inputLen,
+                         OperationFactory& factory, const std::vector<FanOutTarget>& targets, const CallContext& context = CallContext{}) {
+    std::ostringstream transformed;
+    if (!transformJson(definition, shapeCache, inputData, inputLen, transformed)) {
+        return "";
+    }
+    return combineResponses(factory.fanOut(targets, transformed.str(), context));
+}
+
+// Function to transform a stream of records read in fixed-size chunks.
+// Records that fit inside a chunk are parsed where they lie; only records spanning two reads
+// are copied, and never beyond maxRecordBytes. Output is one transformed record per line;
+// records rejected by filter (if given) produce no line, and a record with a malformed string
+// produces an error line (see writeRecordError).
+void transformStream(const std::unordered_map<std::string, std::string>& mapping, std::istream& input, std::ostream& output,
+                     size_t chunkBytes = 64 << 10, size_t maxRecordBytes = 16 << 20, const RecordFilter* filter = nullptr) {
+    ShapeCache shapeCache;
+    ChunkedRecordReader reader(maxRecordBytes);
+    std::vector<char> chunk(chunkBytes);
+    while (input) {
+        input.read(chunk.data(), static_cast<std::streamsize>(chunk.size()));
+        size_t length = static_cast<size_t>(input.gcount());
+        if (length == 0) {
+            break;
+        }
+        reader.feed(chunk.data(), length, [&](char* record, int recordLength) {
+            auto written = tryTransformJson(mapping, shapeCache, record, recordLength, output, filter);
+            if (!written) {
+                writeRecordError(output, written.error());
+            }
+            if (!written || *written) {
+                output << "\n";
+            }
+        });
+    }
+    reader.finish();
+}
+
+// Function to transform a newline-delimited file into another, one output line per record.
+// Input blocks are read ahead and output blocks written behind on io_uring (see BlockReader,
+// BlockWriter), so the parser rarely waits on the disk; without io_uring this is plain
+// pread/pwrite. Bad records are reported line by line as in transformStream. Returns the number
+// of records read.
+size_t transformFile(const std::unordered_map<std::string, std::string>& mapping, const std::string& inputPath, const std::string& outputPath,
+                     const IoConfig& io = IoConfig{}, size_t maxRecordBytes = 16 << 20, const RecordFilter* filter = nullptr) {
+    BlockReader input(inputPath, io);
+    BlockWriter sink(outputPath, io);
+    std::ostream output(&sink);
+    ShapeCache shapeCache;
+    ChunkedRecordReader reader(maxRecordBytes);
+    char* block = nullptr;
+    size_t length = 0;
+    while (input.next(block, length)) {
+        reader.feed(block, length, [&](char* record, int recordLength) {
+            auto written = tryTransformJson(mapping, shapeCache, record, recordLength, output, filter);
+            if (!written) {
+                writeRecordError(output, written.error());
+            }
+            if (!written || *written) {
+                output << "\n";
+            }
+        });
+    }
+    reader.finish();
+    sink.close();
+    return reader.records();
+}
+
+// Function to locate the elements of a top-level JSON array in place.
+// A single pass over the bytes that tracks only strings and nesting (ChunkedRecordReader fed one
+// chunk, so every element is reported where it lies and nothing is copied). Elements must be
+// objects or arrays, as in our bulk exports.
+std::vector<std::pair<char*, int>> scanArrayElements(char* inputData, size_t inputLen) {
+    auto isSpace = [](char c) { return c == ' ' || c == '\n' || c == '\r' || c == '\t'; };
+    size_t open = 0;
+    while (open < inputLen && isSpace(inputData[open])) {
+        ++open;
+    }
+    size_t close = inputLen;
+    while (close > open && isSpace(inputData[close - 1])) {
+        --close;
+    }
+    if (close - open < 2 || inputData[open] != '[' || inputData[close - 1] != ']') {
+        throw std::runtime_error("Top-level JSON value is not an array");
+    }
+    std::vector<std::pair<char*, int>> elements;
+    ChunkedRecordReader reader(close - open);
+    reader.feed(inputData + open + 1, close - open - 2, [&](char* element, int elementLength) {
+        elements.emplace_back(element, elementLength);
+    });
+    reader.finish();
+    return elements;
+}
+
+// Function to transform a document that is one large top-level array, using several threads.
+// The array is split at element boundaries into `threads` runs of roughly equal byte size;
+// each run is transformed on its own thread with its own ShapeCache, and the runs are written
+// out in their original order as one JSON array. Elements rejected by filter are left out; an
+// element with a malformed string is replaced by its error object (see writeRecordError).
+// With a placement policy every run gets its own pinned thread, so its ShapeCache and output
+// buffer come from the node it runs on; per-node throughput goes to statsOut if given.
+void transformArrayParallel(const std::unordered_map<std::string, std::string>& mapping, char* inputData, size_t inputLen, std::ostream& output,
+                            size_t threads = std::thread::hardware_concurrency(), const RecordFilter* filter = nullptr,
+                            const PlacementPolicy& placement = PlacementPolicy{}, std::ostream* statsOut = nullptr) {
+    std::vector<std::pair<char*, int>> elements = scanArrayElements(inputData, inputLen);
+    size_t totalBytes = 0;
+    for (const auto& element : elements) {
+        totalBytes += static_cast<size_t>(element.second);
+    }
+    threads = std::max<size_t>(1, std::min(threads, elements.size()));
+
+    // bounds[c] .. bounds[c + 1] are the elements of run c.
+    std::vector<size_t> bounds{0};
+    size_t accumulated = 0;
+    for (size_t i = 0; i < elements.size() && bounds.size() < threads; ++i) {
+        accumulated += static_cast<size_t>(elements[i].second);
+        if (accumulated * threads >= totalBytes * bounds.size()) {
+            bounds.push_back(i + 1);
+        }
+    }
+    if (bounds.back() != elements.size()) {
+        bounds.push_back(elements.size());
+    }
+    size_t runs = bounds.size() - 1;
+
+    std::vector<std::string> outputs(runs);
+    std::vector<std::exception_ptr> failures(runs);
+    NodeCounters nodeElements;
+    auto start = std::chrono::steady_clock::now();
+    auto transformRun = [&](size_t run) {
+        Placement slot = placementFor(placement, run);
+        if (placement.enabled()) {
+            applyPlacement(slot, placement.localMemory);
+        }
+        try {
+            ShapeCache shapeCache;
+            std::ostringstream out;
+            // Whether an element is kept is known only once it is written, so every kept
+            // element is followed by a comma and the join below drops each run's last one.
+            for (size_t i = bounds[run]; i < bounds[run + 1]; ++i) {
+                auto written = tryTransformJson(mapping, shapeCache, elements[i].first, elements[i].second, out, filter);
+                if (!written) {
+                    writeRecordError(out, written.error());
+                }
+                if (!written || *written) {
+                    out << ",";
+                }
+            }
+            outputs[run] = out.str();
+            nodeElements.add(slot.node, bounds[run + 1] - bounds[run]);
+        } catch (...) {
+            failures[run] = std::current_exception();
+        }
+    };
+
+    // Run 0 stays on the calling thread unless placement would pin it.
+    size_t firstSpawned = placement.enabled() ? 0 : 1;
+    std::vector<std::thread> workers;
+    for (size_t run = firstSpawned; run < runs; ++run) {
+        workers.emplace_back(transformRun, run);
+    }
+    if (runs > 0 && firstSpawned == 1) {
+        transformRun(0);
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    if (statsOut != nullptr) {
+        nodeElements.report("array", std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(), *statsOut);
+    }
+    for (const auto& failure : failures) {
+        if (failure) {
+            std::rethrow_exception(failure);
+        }
+    }
+
+    output << "[";
+    bool first = true;
+    for (const std::string& text : outputs) {
+        if (text.empty()) {
+            continue;
+        }
+        if (!first) {
+            output << ",";
+        }
+        first = false;
+        output.write(text.data(), static_cast<std::streamsize>(text.size() - 1));
+    }
+    output << "]";
+}
+
+// Function to load a transformation's compiled plan, rebuilding the cache file when it is
+// missing, stale (source size or mtime changed) or from an older format version. Definitions
+// with a "$filter" are refused (std::invalid_argument); use parseTransformationDefinition.
+std::unique_ptr<MappedPlan> loadTransformationPlan(const std::string& transformationPath, const std::string& cachePath) {
+    try {
+        return std::make_unique<MappedPlan>(cachePath, transformationPath);
+    } catch (const std::runtime_error&) {
+        // Fall through and rebuild.
+    }
+    std::ifstream file(transformationPath, std::ios::binary);
+    if (!file) {
+        throw std::runtime_error("Cannot open transformation file " + transformationPath);
+    }
+    std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    TransformationDefinition definition = parseTransformationDefinition(data.data(), static_cast<int>(data.size()));
+    if (!definition.filter.empty()) {
+        // A plan holds the mapping only; caching this one would silently drop the filter.
+        throw std::invalid_argument("Transformation " + transformationPath + " has a $filter, which plan caches cannot hold");
+    }
+    writePlanCache(cachePath, transformationPath, definition.mapping);
+    return std::make_unique<MappedPlan>(cachePath, transformationPath);
+}
+
+// Function to load a reference document's tape, parsing the document only when the cache is
+// missing or stale.
+std::unique_ptr<MappedTape> loadDocumentTape(const std::string& documentPath, const std::string& cachePath,
+                                             const std::function<JSONValue(const std::string&)>& parseDocument) {
+    try {
+        return std::make_unique<MappedTape>(cachePath, documentPath);
+    } catch (const std::runtime_error&) {
+        // Fall through and rebuild.
+    }
+    writeTapeCache(cachePath, documentPath, parseDocument(documentPath));
+    return std::make_unique<MappedTape>(cachePath, documentPath);
+}
+
+// Function to evaluate the index-th path of a mapped plan, comparing keys in place.
+std::string evaluatePlanPath(const PlanView& plan, size_t index, JsonPack& inputPack) {
+    TraceSpan span("evaluateJSONPath", "lookup", plan.path(index));
+    bool found = true;
+    for (size_t s = 0; found && s < plan.stepCount(index); ++s) {
+        std::string_view key = plan.stepKey(index, s);
+        if (inputPack.ReadObject()) {
+            found = false;
+            while (inputPack.ReadMember()) {
+                if (static_cast<size_t>(inputPack.KeyLength()) == key.size() && std::memcmp(inputPack.Key(), key.data(), key.size()) == 0) {
+                    found = true;
+                    break;
+                }
+            }
+        }
+        uint32_t arrayIndex = plan.stepArrayIndex(index, s);
+        if (found && arrayIndex != kNoArrayIndex) {
+            found = advanceToArrayIndex(inputPack, arrayIndex);
+        }
+    }
+    return found ? packValueToString(inputPack) : std::string();
+}
+
+// Function to transform the input JSON with a plan read straight from the mapped cache;
+// keys and path steps are compared in place, never copied out.
+void transformJson(const PlanView& plan, char* inputData, int inputLen, std::ostream& output) {
+    TraceSpan span("transformJson");
+    JsonPack inputPack(inputData, inputLen);
+
+    output << "{";
+    if (openRecord(inputPack)) {
+        for (size_t i = 0; i < plan.size(); ++i) {
+            if (i > 0) {
+                output << ",";
+            }
+            std::string value = evaluatePlanPath(plan, i, inputPack);
+            TraceSpan format("format", "output");
+            writeField(output, plan.field(i), value);
+        }
+    }
+    output << "}";
+}
+
+// Define the IncrementalTransformer class.
+// Keeps a transformed document and its output, and applies RFC 6902 JSON Patch deltas to both.
+// A trie indexed by source path tokens maps every location in the input to the output fields
+// that read from it, so a patch recomputes only the fields under (or above) the paths it
+// touches. Every other output field is left as is and never re-extracted.
+class IncrementalTransformer {
+public:
+    struct OutputChange {
+        std::string op;     // "replace" for now: output fields always exist
+        std::string field;
+        std::string value;
+    };
+
+private:
+    struct IndexNode {
+        std::unordered_map<std::string, std::unique_ptr<IndexNode>> children;
+        std::vector<size_t> fields;  // output fields whose source path ends here
+    };
+
+    JSONValue document;
+    std::vector<std::string> fieldNames;
+    std::vector<std::string> sourcePaths;
+    std::vector<std::string> values;
+    IndexNode index;
+    uint64_t recomputed = 0;
+
+    // "a.b[1].c" -> {"a", "b", "1", "c"}, matching the tokens of a JSON Pointer.
+    static std::vector<std::string> sourceTokens(const std::string& path) {
+        std::vector<std::string> tokens;
+        for (const std::string& part : split(path, '.')) {
+            size_t bracket = part.find('[');
+            tokens.push_back(part.substr(0, bracket));
+            while (bracket != std::string::npos) {
+                size_t close = part.find(']', bracket);
+                tokens.push_back(part.substr(bracket + 1, close - bracket - 1));
+                bracket = part.find('[', close);
+            }
+        }
+        return tokens;
+    }
+
+    static std::vector<std::string> pointerTokens(const std::string& pointer) {
+        if (!pointer.empty() && pointer[0] != '/') {
+            throw std::invalid_argument("Invalid JSON Pointer: " + pointer);
+        }
+        std::vector<std::string> tokens;
+        size_t start = 1;
+        while (start <= pointer.size() && !pointer.empty()) {
+            size_t end = pointer.find('/', start);
+            std::string token = pointer.substr(start, end == std::string::npos ? std::string::npos : end - start);
+            for (size_t pos = 0; (pos = token.find('~', pos)) != std::string::npos; ++pos) {
+                token.replace(pos, 2, token.compare(pos, 2, "~1") == 0 ? "/" : "~");
+            }
+            tokens.push_back(token);
+            if (end == std::string::npos) {
+                break;
+            }
+            start = end + 1;
+        }
+        return tokens;
+    }
+
+    static const std::string& memberString(const JSONValue& op, const std::string& name) {
+        const auto& object = op.getObject();
+        auto it = object.find(name);
+        if (it == object.end() || !std::holds_alternative<std::string>(it->second.value)) {
+            throw std::invalid_argument("JSON Patch operation is missing '" + name + "'");
+        }
+        return std::get<std::string>(it->second.value);
+    }
+
+    static size_t arrayIndex(const std::string& token, size_t size, bool allowEnd) {
+        if (allowEnd && token == "-") {
+            return size;
+        }
+        size_t index = 0;
+        auto parsed = std::from_chars(token.data(), token.data() + token.size(), index);
+        if (parsed.ec != std::errc() || parsed.ptr != token.data() + token.size() || index > size || (!allowEnd && index == size)) {
+            throw std::out_of_range("JSON Patch array index out of range: " + token);
+        }
+        return index;
+    }
+
+    JSONValue& locate(const std::vector<std::string>& tokens, size_t count) {
+        JSONValue* current = &document;
+        for (size_t i = 0; i < count; ++i) {
+            if (current->isObject()) {
+                auto it = current->getObject().find(tokens[i]);
+                if (it == current->getObject().end()) {
+                    throw std::out_of_range("JSON Patch path not found: " + tokens[i]);
+                }
+                current = &it->second;
+            } else if (current->isArray()) {
+                current = &current->getArray()[arrayIndex(tokens[i], current->getArray().size(), false)];
+            } else {
+                throw std::out_of_range("JSON Patch path goes through a scalar at: " + tokens[i]);
+            }
+        }
+        return *current;
+    }
+
+    JSONValue removeAt(const std::vector<std::string>& tokens) {
+        if (tokens.empty()) {
+            throw std::invalid_argument("JSON Patch cannot remove the whole document");
+        }
+        JSONValue& parent = locate(tokens, tokens.size() - 1);
+        const std::string& last = tokens.back();
+        JSONValue removed;
+        if (parent.isObject()) {
+            auto it = parent.getObject().find(last);
+            if (it == parent.getObject().end()) {
+                throw std::out_of_range("JSON Patch path not found: " + last);
+            }
+            removed = std::move(it->second);
+            parent.getObject().erase(it);
+        } else if (parent.isArray()) {
+            auto& array = parent.getArray();
+            size_t index = arrayIndex(last, array.size(), false);
+            removed = std::move(array[index]);
+            array.erase(array.begin() + index);
+        } else {
+            throw std::out_of_range("JSON Patch parent is not a container: " + last);
+        }
+        return removed;
+    }
+
+    // Returns true if the value went into an array, which shifts the elements after it.
+    bool addAt(const std::vector<std::string>& tokens, JSONValue value, bool replace) {
+        if (tokens.empty()) {
+            document = std::move(value);
+            return false;
+        }
+        JSONValue& parent = locate(tokens, tokens.size() - 1);
+        const std::string& last = tokens.back();
+        if (parent.isObject()) {
+            if (replace && parent.getObject().find(last) == parent.getObject().end()) {
+                throw std::out_of_range("JSON Patch replace target not found: " + last);
+            }
+            parent.getObject()[last] = std::move(value);
+            return false;
+        }
+        if (!parent.isArray()) {
+            throw std::out_of_range("JSON Patch parent is not a container: " + last);
+        }
+        auto& array = parent.getArray();
+        if (replace) {
+            array[arrayIndex(last, array.size(), false)] = std::move(value);
+            return false;
+        }
+        array.insert(array.begin() + arrayIndex(last, array.size(), true), std::move(value));
+        return true;
+    }
+
+    void collectSubtree(const IndexNode& node, std::vector<bool>& affected) const {
+        for (size_t field : node.fields) {
+            affected[field] = true;
+        }
+        for (const auto& child : node.children) {
+            collectSubtree(*child.second, affected);
+        }
+    }
+
+    // Mark fields reading from tokens, from any ancestor of it, or from anything beneath it.
+    // With wholeParent, everything under the parent is marked (array insert/remove shifts siblings).
+    void markAffected(const std::vector<std::string>& tokens, bool wholeParent, std::vector<bool>& affected) const {
+        size_t depth = wholeParent && !tokens.empty() ? tokens.size() - 1 : tokens.size();
+        const IndexNode* node = &index;
+        for (size_t i = 0; i < depth; ++i) {
+            for (size_t field : node->fields) {
+                affected[field] = true;
+            }
+            auto it = node->children.find(tokens[i]);
+            if (it == node->children.end()) {
+                return;
+            }
+            node = it->second.get();
+        }
+        collectSubtree(*node, affected);
+    }
+
+    std::string extract(size_t field) {
+        ++recomputed;
+        auto found = tryExtractValue(document, sourcePaths[field]);
+        if (!found) {
+            return "";
+        }
+        const JSONValue& value = **found;
+        if (std::holds_alternative<std::string>(value.value)) {
+            return std::get<std::string>(value.value);
+        }
+        return std::to_string(value);
+    }
+
+public:
+    IncrementalTransformer(const std::unordered_map<std::string, std::string>& mapping, JSONValue input)
+        : document(std::move(input)) {
+        for (const auto& pair : mapping) {
+            size_t field = fieldNames.size();
+            fieldNames.push_back(pair.first);
+            sourcePaths.push_back(pair.second);
+            IndexNode* node = &index;
+            for (const std::string& token : sourceTokens(pair.second)) {
+                auto& child = node->children[token];
+                if (!child) {
+                    child = std::make_unique<IndexNode>();
+                }
+                node = child.get();
+            }
+            node->fields.push_back(field);
+        }
+        for (size_t field = 0; field < fieldNames.size(); ++field) {
+            values.push_back(extract(field));
+        }
+    }
+
+    // Apply a JSON Patch (an array of operations) and return the output fields that changed.
+    // Supports add, remove, replace, move, copy and test; a failed test throws and, as RFC 6902
+    // requires, the caller should discard the transformer since earlier operations were applied.
+    std::vector<OutputChange> applyPatch(const JSONValue& patch) {
+        if (!patch.isArray()) {
+            throw std::invalid_argument("JSON Patch must be an array");
+        }
+        std::vector<bool> affected(fieldNames.size(), false);
+        for (const JSONValue& operation : patch.getArray()) {
+            const std::string& op = memberString(operation, "op");
+            std::vector<std::string> path = pointerTokens(memberString(operation, "path"));
+            if (op == "add" || op == "replace") {
+                bool shifted = addAt(path, operation.getObject().at("value"), op == "replace");
+                markAffected(path, shifted, affected);
+            } else if (op == "remove") {
+                JSONValue& parent = locate(path, path.empty() ? 0 : path.size() - 1);
+                bool shifted = parent.isArray();
+                removeAt(path);
+                markAffected(path, shifted, affected);
+            } else if (op == "move" || op == "copy") {
+                std::vector<std::string> from = pointerTokens(memberString(operation, "from"));
+                JSONValue value;
+                if (op == "move") {
+                    bool shifted = !from.empty() && locate(from, from.size() - 1).isArray();
+                    value = removeAt(from);
+                    markAffected(from, shifted, affected);
+                } else {
+                    value = locate(from, from.size());
+                }
+                bool shifted = addAt(path, std::move(value), false);
+                markAffected(path, shifted, affected);
+            } else if (op == "test") {
+                if (std::to_string(locate(path, path.size())) != std::to_string(operation.getObject().at("value"))) {
+                    throw std::runtime_error("JSON Patch test failed at " + memberString(operation, "path"));
+                }
+            } else {
+                throw std::invalid_argument("Unsupported JSON Patch operation: " + op);
+            }
+        }
+
+        std::vector<OutputChange> changes;
+        for (size_t field = 0; field < fieldNames.size(); ++field) {
+            if (!affected[field]) {
+                continue;
+            }
+            std::string value = extract(field);
+            if (value != values[field]) {
+                values[field] = value;
+                changes.push_back({"replace", fieldNames[field], std::move(value)});
+            }
+        }
+        return changes;
+    }
+
+    // Write the full output in transformJson's format.
+    void writeOutput(std::ostream& output) const {
+        output << "{";
+        for (size_t field = 0; field < fieldNames.size(); ++field) {
+            if (field > 0) {
+                output << ",";
+            }
+            writeField(output, fieldNames[field], values[field]);
+        }
+        output << "}";
+    }
+
+    // Write changes as an output-side JSON Patch.
+    static void writeOutputPatch(const std::vector<OutputChange>& changes, std::ostream& output) {
+        output << "[";
+        for (size_t i = 0; i < changes.size(); ++i) {
+            if (i > 0) {
+                output << ",";
+            }
+            output << "{\"op\": \"" << changes[i].op << "\", \"path\": \"/";
+            writeEscapedJson(output, changes[i].field);
+            output << "\", \"value\": \"";
+            writeEscapedJson(output, changes[i].value);
+            output << "\"}";
+        }
+        output << "]";
+    }
+
+    uint64_t fieldsRecomputed() const {
+        return recomputed;
+    }
+};
+
+// The typed messages the pipeline can build for the built-in services; monostate means the
+// record is sent as request text instead.
+using PipelineMessage = std::variant<std::monostate, OeMsg, XyzMsg>;
+using PipelineBinding = std::variant<std::monostate, MessageBinding<OeMsg>, MessageBinding<XyzMsg>>;
+
+// Function to pick the message binding for a target service. A mapping with fields the message
+// does not have gets none, so no mapped value is silently left out of the request.
+PipelineBinding makePipelineBinding(const std::string& serviceName, const std::unordered_map<std::string, std::string>& mapping) {
+    PipelineBinding binding;
+    if (serviceName == "OEPY") {
+        binding.emplace<MessageBinding<OeMsg>>(mapping);
+    } else if (serviceName == "XYZ") {
+        binding.emplace<MessageBinding<XyzMsg>>(mapping);
+    }
+    bool complete = std::visit([](const auto& b) {
+        if constexpr (std::is_same_v<std::decay_t<decltype(b)>, std::monostate>) {
+            return false;
+        } else {
+            return b.unbound().empty();
+        }
+    }, binding);
+    if (!complete) {
+        binding.emplace<std::monostate>();
+    }
+    return binding;
+}
+
+// Define the record carried through the transform-to-dispatch pipeline.
+struct PipelineRecord {
+    std::string raw;
+    std::string transformed;
+    std::string requestData;
+    PipelineMessage message;
+    std::string response;
+    std::string error;
+    TraceRecord trace;  // sampled once at ingest; every stage traces the record under it
+};
+
+// Where every transformed record is sent.
+struct DispatchTarget {
+    std::string serviceName;
+    std::string operationName;
+    std::string url;
+};
+
+struct PipelineConfig {
+    size_t queueCapacity = 1024;
+    size_t transformThreads = 2;
+    size_t convertThreads = 1;
+    size_t executeThreads = 2;
+    std::chrono::milliseconds reportInterval{0};  // 0 disables periodic stats
+    DedupCache* dedupCache = nullptr;             // opt-in reuse of outputs for replayed records
+    uint64_t mappingVersion = 0;
+    const RecordFilter* filter = nullptr;         // rejected records are dropped in the transform stage
+    PlacementPolicy placement;                    // pin stage threads to cores and node-local memory
+};
+
+// Function to run ingest -> transform -> convert -> execute -> write in one process.
+// Input is newline-delimited JSON. JsonPack parses lazily while the mapping is evaluated, so
+// parsing and transformation share a stage. Each execute thread owns its own OperationFactory.
+// When the target is a built-in service whose message covers every mapped field, the transform
+// stage only filters and the convert stage binds each record straight into that message
+// (see MessageBinding), which execute sends with dispatchTyped. Otherwise, and whenever a
+// dedupCache is set (it caches request text), transform writes the request text and convert
+// passes it on.
+void runTransformPipeline(const std::unordered_map<std::string, std::string>& mapping, const DispatchTarget& target,
+                          std::istream& input, std::ostream& output, const PipelineConfig& config, std::ostream& statsOut) {
+    StagedPipeline<PipelineRecord> pipeline(config.queueCapacity);
+    pipeline.setPlacement(config.placement);
+
+    const PipelineBinding binding = config.dedupCache != nullptr ? PipelineBinding() : makePipelineBinding(target.serviceName, mapping);
+    const bool typed = !std::holds_alternative<std::monostate>(binding);
+
+    pipeline.addStage("transform", config.transformThreads, [&mapping, &config, typed]() {
+        auto shapeCache = std::make_shared<ShapeCache>();
+        return [&mapping, &config, typed, shapeCache](PipelineRecord& record) {
+            TraceRecordScope traceScope(record.trace);
+            try {
+                if (typed) {
+                    return config.filter == nullptr || config.filter->matches(record.raw.data(), static_cast<int>(record.raw.size()));
+                }
+                std::ostringstream out;
+                if (config.dedupCache != nullptr) {
+                    // A dedup hit skips the parse, so the filter is tested on its own first.
+                    if (config.filter != nullptr && !config.filter->matches(record.raw.data(), static_cast<int>(record.raw.size()))) {
+                        return false;
+                    }
+                    transformJson(mapping, config.mappingVersion, *config.dedupCache, *shapeCache, record.raw.data(), static_cast<int>(record.raw.size()), out);
+                } else if (!transformJson(mapping, *shapeCache, record.raw.data(), static_cast<int>(record.raw.size()), out, config.filter)) {
+                    return false;
+                }
+                record.transformed = out.str();
+            } catch (const std::exception& e) {
+                record.error = e.what();
+            }
+            return true;
+        };
+    });
+    pipeline.addStage("convert", config.convertThreads, [&binding]() {
+        return [&binding](PipelineRecord& record) {
+            TraceRecordScope traceScope(record.trace);
+            if (record.error.empty()) {
+                std::visit([&record](const auto& messageBinding) {
+                    using Binding = std::decay_t<decltype(messageBinding)>;
+                    if constexpr (std::is_same_v<Binding, std::monostate>) {
+                        record.requestData = std::move(record.transformed);
+                    } else {
+                        auto& message = record.message.template emplace<typename Binding::Message>();
+                        auto bound = messageBinding.bind(record.raw.data(), static_cast<int>(record.raw.size()), message);
+                        if (!bound) {
+                            record.error = bound.error().message();
+                        } else if (!*bound) {
+                            record.error = "Input record is not a JSON object";
+                        }
+                    }
+                }, binding);
+            }
+            std::string().swap(record.raw);
+            return true;
+        };
+    });
+    pipeline.addStage("execute", config.executeThreads, [&target]() {
+        auto factory = std::make_shared<OperationFactory>();
+        return [factory, &target](PipelineRecord& record) {
+            TraceRecordScope traceScope(record.trace);
+            if (record.error.empty()) {
+                try {
+                    record.response = std::visit([&](const auto& message) {
+                        if constexpr (std::is_same_v<std::decay_t<decltype(message)>, std::monostate>) {
+                            return factory->dispatch(target.serviceName, target.operationName, target.url, record.requestData);
+                        } else {
+                            return factory->dispatchTyped(target.serviceName, target.operationName, target.url, message);
+                        }
+                    }, record.message);
+                } catch (const std::exception& e) {
+                    record.error = e.what();
+                }
+            }
+            return true;
+        };
+    });
+
+    std::atomic<bool> finished{false};
+    std::thread reporter;
+    if (config.reportInterval.count() > 0) {
+        reporter = std::thread([&]() {
+            while (!finished.load()) {
+                std::this_thread::sleep_for(config.reportInterval);
+                pipeline.report(statsOut);
+            }
+        });
+    }
+
+    std::string line;
+    pipeline.run(
+        [&](PipelineRecord& record) {
+            while (std::getline(input, line)) {
+                if (line.find_first_not_of(" \t\r") != std::string::npos) {
+                    record.raw = std::move(line);
+                    record.trace = Tracer::beginRecord();
+                    return true;
+                }
+            }
+            return false;
+        },
+        [&](PipelineRecord& record) {
+            if (record.error.empty()) {
+                output << record.response << "\n";
+            } else {
+                output << "Error: " << record.error << "\n";
+            }
+        },
+        [&](PipelineRecord&, const std::string& error) {
+            output << "Error: " << error << "\n";
+        });
+
+    finished.store(true);
+    if (reporter.joinable()) {
+        reporter.join();
+    }
+    pipeline.report(statsOut);
+    if (config.dedupCache != nullptr) {
+        config.dedupCache->report(statsOut);
+    }
+}
+
+// Function to compare the throwing and the Expected-based paths on a miss-heavy workload:
+// 3 of every 10 lookups and dispatches fail, as with feeds that often omit optional fields.
+void benchmarkMissHeavy(std::ostream& out, size_t iterations) {
+    using JSONObjectType = std::decay_t<decltype(std::declval<JSONValue&>().getObject())>;
+    using JSONArrayType = std::decay_t<decltype(std::declval<JSONValue&>().getArray())>;
+
+    JSONObjectType typeDetails;
+    typeDetails["externalRefNum"] = JSONValue(std::string("ke113n"));
+    typeDetails["siType"] = JSONValue(std::string("STANDING"));
+    JSONObjectType amountDetails;
+    amountDetails["amounts"] = JSONValue(JSONArrayType{JSONValue(100.0), JSONValue(200.0)});
+    amountDetails["frequency"] = JSONValue(std::string("MONTHLY"));
+    JSONObjectType root;
+    root["exasSITypeDtls"] = JSONValue(typeDetails);
+    root["exasSIAmtAndFreqDtls"] = JSONValue(amountDetails);
+    JSONValue document(root);
+
+    const std::vector<std::string> paths = {
+        "exasSITypeDtls.externalRefNum", "exasSIAmtAndFreqDtls.amounts[1]", "exasSITypeDtls.mandateRef",
+        "exasSITypeDtls.siType", "exasSIAmtAndFreqDtls.frequency", "exasSIAmtAndFreqDtls.amounts[5]",
+        "exasSIAmtAndFreqDtls.amounts[0]", "exasSITypeDtls.externalRefNum", "exasSIChargeDtls.fee",
+        "exasSIAmtAndFreqDtls.frequency",
+    };
+    const std::vector<std::string> operations = {"create", "read", "update", "newFunction", "read", "delete", "create", "read", "archive", "create"};
+
+    auto timeIt = [&](const char* label, auto&& body) {
+        size_t misses = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < iterations; ++i) {
+            misses += body(i % paths.size());
+        }
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / iterations;
+        out << label << ": " << ns << " ns/op (" << misses << " misses)" << std::endl;
+    };
+
+    timeIt("extractValue (throws on miss)", [&](size_t i) -> size_t {
+        try {
+            extractValue(document, paths[i]);
+            return 0;
+        } catch (const std::exception&) {
+            return 1;
+        }
+    });
+    timeIt("tryExtractValue (Expected)", [&](size_t i) -> size_t {
+        return tryExtractValue(document, paths[i]) ? 0 : 1;
+    });
+
+    OperationFactory factory;
+    timeIt("OperationFactory::dispatch (throws on miss)", [&](size_t i) -> size_t {
+        try {
+            factory.dispatch("OEPY", operations[i], "http://oe.host/oe/api", "Request Data");
+            return 0;
+        } catch (const std::exception&) {
+            return 1;
+        }
+    });
+    timeIt("OperationFactory::tryDispatch (Expected)", [&](size_t i) -> size_t {
+        return factory.tryDispatch("OEPY", operations[i], "http://oe.host/oe/api", "Request Data") ? 0 : 1;
+    });
+}
+
+// Function to report string ingest throughput: the old raw copy against UTF-8 validation and
+// full unescaping, scalar and vectorized, on ASCII-only, multi-byte and escape-heavy values.
+void benchmarkStringDecoding(std::ostream& out, size_t megabytes) {
+    const std::vector<std::pair<const char*, std::string>> inputs = {
+        {"ascii", "STANDING INSTRUCTION ke113n MONTHLY 2024-01-31 ref 0042"},
+        {"utf-8", "Zahlungsempf\xc3\xa4nger M\xc3\xbcller \xe6\x97\xa5\xe6\x9c\xac\xe8\xaa\x9e caf\xc3\xa9 2024"},
+        {"multibyte", "\xd0\x9f\xd0\xbb\xd0\xb0\xd1\x82\xd0\xb5\xd0\xb6 \xd0\xbf\xd0\xbe \xd0\xb4\xd0\xbe\xd0\xb3\xd0\xbe\xd0\xb2\xd0\xbe\xd1\x80\xd1\x83 "
+                      "\xe6\x94\xaf\xe6\x89\x95\xe6\x8c\x87\xe7\xa4\xba\xe6\x9b\xb8 \xce\xb5\xce\xbd\xcf\x84\xce\xbf\xce\xbb\xce\xae \xf0\x9f\x92\xb6\xf0\x9f\x93\x84"},
+        {"escape-heavy", "caf\\u00e9 \\\"quoted\\\"\\n\\tline \\ud83d\\ude00 C:\\\\path\\\\to"},
+    };
+    size_t totalBytes = megabytes << 20;
+
+    auto timeIt = [&](const char* input, const char* label, const std::string& value, auto&& body) {
+        size_t count = std::max<size_t>(1, totalBytes / value.size());
+        size_t checksum = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < count; ++i) {
+            checksum += body(std::string_view(value));
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        out << input << " " << label << ": " << static_cast<uint64_t>(count * value.size() / seconds / (1 << 20)) << " MB/s (" << checksum << ")" << std::endl;
+    };
+
+    for (const auto& [name, value] : inputs) {
+        timeIt(name, "raw copy (no checks)", value, [](std::string_view raw) { return std::string(raw).size(); });
+        timeIt(name, "validate, scalar", value, [](std::string_view raw) {
+            size_t i = 0;
+            while (i < raw.size()) {
+                size_t sequence = utf8SequenceLength(raw.data() + i, raw.size() - i);
+                if (sequence == 0) {
+                    break;
+                }
+                i += sequence;
+            }
+            return i;
+        });
+        timeIt(name, "validate, vectorized", value, [](std::string_view raw) { return invalidUtf8Offset(raw.data(), raw.size()); });
+        timeIt(name, "decode + validate", value, [](std::string_view raw) {
+            auto decoded = tryDecodeJsonString(raw);
+            return decoded ? (*decoded).size() : 0;
+        });
+    }
+}
+
+// Function to check that the shape cache gives the same output as a plain lookup when a feed's
+// records change shape: keys reordered, members added or dropped, values growing. Returns the
+// number of records that disagreed.
+size_t selfCheckShapeCache(std::ostream& out) {
+    const std::vector<std::string> records = {
+        R"({"a": {"x": "1", "y": "2"}, "b": [10, 20], "c": "three"})",
+        R"({"c": "three", "b": [10, 20], "a": {"y": "2", "x": "1"}})",
+        R"({"b": [10, 20], "a": {"x": "1", "y": "2"}, "c": "three"})",
+        R"({"a": {"x": "1", "y": "2"}, "b": [10, 20], "c": "three"})",
+        R"({"zz": "padding that pushes every key along", "a": {"x": "1"}, "c": "three"})",
+        R"({"a": {"y": "2", "x": "1"}, "c": "three", "b": [10, 20]})",
+        R"({"c": "a", "a": {"x": "c", "y": "b"}})",
+        R"({"a": {"x": "1", "y": "2"}, "b": [10, 20], "c": "three"})",
+    };
+    const std::unordered_map<std::string, std::string> mapping = {
+        {"ax", "a.x"}, {"ay", "a.y"}, {"b1", "b[1]"}, {"c", "c"},
+    };
+
+    ShapeCache shapeCache;
+    size_t failures = 0;
+    for (size_t i = 0; i < records.size(); ++i) {
+        std::string record = records[i];
+        std::ostringstream expected;
+        std::ostringstream cached;
+        transformJson(mapping, record.data(), static_cast<int>(record.size()), expected);
+        transformJson(mapping, shapeCache, record.data(), static_cast<int>(record.size()), cached);
+        if (cached.str() != expected.str()) {
+            ++failures;
+            out << "shape cache mismatch on record " << i << ": " << cached.str() << " != " << expected.str() << std::endl;
+        }
+    }
+    shapeCache.report("self-check", out);
+    return failures;
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1 && std::string(argv[1]) == "--self-check") {
+        return selfCheckShapeCache(std::cout) == 0 ? 0 : 1;
+    }
+    if (argc > 1 && std::string(argv[1]) == "--bench-miss") {
+        benchmarkMissHeavy(std::cout, argc > 2 ? std::stoul(argv[2]) : 1000000);
+        return 0;
+    }
+    if (argc > 1 && std::string(argv[1]) == "--bench-strings") {
+        benchmarkStringDecoding(std::cout, argc > 2 ? std::stoul(argv[2]) : 256);
+        return 0;
+    }
+    // --transform-file <transformation> <input> <output>: NDJSON in, NDJSON out.
+    if (argc > 4 && std::string(argv[1]) == "--transform-file") {
+        std::ifstream transformationFile(argv[2], std::ios::binary);
+        std::string transformation((std::istreambuf_iterator<char>(transformationFile)), std::istreambuf_iterator<char>());
+        auto mapping = parseTransformationJson(transformation.data(), static_cast<int>(transformation.size()));
+        auto start = std::chrono::steady_clock::now();
+        size_t records = transformFile(mapping, argv[3], argv[4]);
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cerr << records << " records in " << elapsed << " s (" << (IoUring::supported() ? "io_uring" : "pread/pwrite") << ")" << std::endl;
+        return 0;
+    }
+    // --trace <file> [rate]: record sampled spans and write them as a Chrome trace.
+    std::string tracePath;
+    if (argc > 2 && std::string(argv[1]) == "--trace") {
+        tracePath = argv[2];
+        Tracer::setSampleRate(argc > 3 ? std::stod(argv[3]) : 1.0);
+    }
+
     char inputData[] = R"({
         "exasSITypeDtls": {
             "externalRefNum": "ke113n"
@@ -1182,5 +3066,9 @@ int main() {
     std::cout << "Transformed JSON: ";
     transformJson(mapping, inputData, sizeof(inputData) - 1, std::cout);
 
+    if (!tracePath.empty() && !Tracer::writeChromeTrace(tracePath)) {
+        std::cerr << "Could not write trace to " << tracePath << std::endl;
+        return 1;
+    }
     return 0;
 }
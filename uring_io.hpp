@@ -0,0 +1,558 @@
+#ifndef URING_IO_H
+#define URING_IO_H
+
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <stdexcept>
+#include <streambuf>
+#include <string>
+#include <system_error>
+#include <vector>
+
+// Block file I/O for the batch transformer on io_uring, through the raw syscalls (no liburing).
+// Several reads and writes are kept in flight on buffers registered with the kernel once, so
+// the parser works on one block while the next ones are already being read, and formatted
+// output is written back while more is produced. Where io_uring is unavailable (old kernel,
+// seccomp, io_uring_disabled) the same classes fall back to blocking pread/pwrite.
+
+struct IoConfig {
+    size_t blockBytes = 1 << 20;  // size of each read or write
+    unsigned readDepth = 4;       // input blocks in flight; 2 is plain double buffering
+    unsigned writeDepth = 4;      // output blocks in flight
+    bool useUring = true;         // false forces the blocking fallback
+};
+
+// Define the IoUring class: one submission/completion ring pair, used by a single thread.
+class IoUring {
+private:
+    int ringFd = -1;
+    void* sqRing = MAP_FAILED;
+    void* cqRing = MAP_FAILED;
+    size_t sqRingBytes = 0;
+    size_t cqRingBytes = 0;
+    io_uring_sqe* sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+    size_t sqesBytes = 0;
+
+    unsigned* sqHead = nullptr;
+    unsigned* sqTail = nullptr;
+    unsigned* sqArray = nullptr;
+    unsigned sqMask = 0;
+    unsigned sqEntries = 0;
+    unsigned* cqHead = nullptr;
+    unsigned* cqTail = nullptr;
+    io_uring_cqe* cqes = nullptr;
+    unsigned cqMask = 0;
+
+    unsigned localTail = 0;
+    unsigned unsubmitted = 0;
+
+    void release() {
+        if (sqes != MAP_FAILED) {
+            ::munmap(sqes, sqesBytes);
+        }
+        if (cqRing != MAP_FAILED && cqRing != sqRing) {
+            ::munmap(cqRing, cqRingBytes);
+        }
+        if (sqRing != MAP_FAILED) {
+            ::munmap(sqRing, sqRingBytes);
+        }
+        if (ringFd >= 0) {
+            ::close(ringFd);
+        }
+    }
+
+    void fail(const char* what) {
+        int error = errno;
+        release();
+        throw std::system_error(error, std::generic_category(), what);
+    }
+
+public:
+    explicit IoUring(unsigned entries) {
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+        ringFd = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+        if (ringFd < 0) {
+            throw std::system_error(errno, std::generic_category(), "io_uring_setup");
+        }
+        sqRingBytes = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqRingBytes = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool singleMap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (singleMap) {
+            sqRingBytes = cqRingBytes = std::max(sqRingBytes, cqRingBytes);
+        }
+        sqRing = ::mmap(nullptr, sqRingBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+        if (sqRing == MAP_FAILED) {
+            fail("io_uring sq ring mmap");
+        }
+        cqRing = singleMap ? sqRing : ::mmap(nullptr, cqRingBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+        if (cqRing == MAP_FAILED) {
+            fail("io_uring cq ring mmap");
+        }
+        sqesBytes = params.sq_entries * sizeof(io_uring_sqe);
+        sqes = static_cast<io_uring_sqe*>(::mmap(nullptr, sqesBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES));
+        if (sqes == MAP_FAILED) {
+            fail("io_uring sqes mmap");
+        }
+
+        char* sq = static_cast<char*>(sqRing);
+        sqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+        sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        sqMask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sqEntries = params.sq_entries;
+        char* cq = static_cast<char*>(cqRing);
+        cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+        cqMask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        localTail = *sqTail;
+    }
+
+    IoUring(const IoUring&) = delete;
+    IoUring& operator=(const IoUring&) = delete;
+
+    ~IoUring() {
+        release();
+    }
+
+    // Whether this kernel and process may use io_uring at all; probed once.
+    static bool supported() {
+        static const bool usable = [] {
+            try {
+                IoUring probe(2);
+                return true;
+            } catch (const std::system_error&) {
+                return false;
+            }
+        }();
+        return usable;
+    }
+
+    // Pin buffers for READ_FIXED/WRITE_FIXED. False if the kernel refused (e.g. RLIMIT_MEMLOCK);
+    // the buffers then still work with plain READ/WRITE.
+    bool registerBuffers(const std::vector<iovec>& buffers) {
+        return ::syscall(__NR_io_uring_register, ringFd, IORING_REGISTER_BUFFERS, buffers.data(), static_cast<unsigned>(buffers.size())) == 0;
+    }
+
+    // Queue one read or write; bufferIndex < 0 means the buffer is not registered.
+    void prepare(uint8_t opcode, int fd, void* data, unsigned length, uint64_t offset, uint64_t userData, int bufferIndex = -1) {
+        if (localTail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) == sqEntries) {
+            submit();
+        }
+        unsigned index = localTail & sqMask;
+        io_uring_sqe& sqe = sqes[index];
+        std::memset(&sqe, 0, sizeof(sqe));
+        sqe.opcode = opcode;
+        sqe.fd = fd;
+        sqe.addr = reinterpret_cast<uint64_t>(data);
+        sqe.len = length;
+        sqe.off = offset;
+        sqe.user_data = userData;
+        if (bufferIndex >= 0) {
+            sqe.buf_index = static_cast<uint16_t>(bufferIndex);
+        }
+        sqArray[index] = index;
+        ++localTail;
+        ++unsubmitted;
+        __atomic_store_n(sqTail, localTail, __ATOMIC_RELEASE);
+    }
+
+    // Hand queued entries to the kernel, optionally waiting for minComplete completions.
+    void submit(unsigned minComplete = 0) {
+        for (;;) {
+            unsigned flags = minComplete > 0 ? IORING_ENTER_GETEVENTS : 0;
+            int submitted = static_cast<int>(::syscall(__NR_io_uring_enter, ringFd, unsubmitted, minComplete, flags, nullptr, 0));
+            if (submitted >= 0) {
+                unsubmitted -= std::min<unsigned>(unsubmitted, static_cast<unsigned>(submitted));
+                return;
+            }
+            if (errno != EINTR) {
+                throw std::system_error(errno, std::generic_category(), "io_uring_enter");
+            }
+        }
+    }
+
+    bool tryComplete(uint64_t& userData, int& result) {
+        unsigned head = *cqHead;
+        if (head == __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) {
+            return false;
+        }
+        const io_uring_cqe& cqe = cqes[head & cqMask];
+        userData = cqe.user_data;
+        result = cqe.res;
+        __atomic_store_n(cqHead, head + 1, __ATOMIC_RELEASE);
+        return true;
+    }
+
+    void waitComplete(uint64_t& userData, int& result) {
+        while (!tryComplete(userData, result)) {
+            submit(1);
+        }
+    }
+};
+
+// Define the IoBuffers class: depth page-aligned blocks in one mapping, registered with a
+// ring when one is used.
+class IoBuffers {
+private:
+    char* base = static_cast<char*>(MAP_FAILED);
+    size_t blockBytes;
+    size_t depth;
+    bool registered = false;
+
+public:
+    IoBuffers(size_t blockBytes, size_t depth, IoUring* ring) : blockBytes(blockBytes), depth(depth) {
+        base = static_cast<char*>(::mmap(nullptr, blockBytes * depth, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+        if (base == MAP_FAILED) {
+            throw std::system_error(errno, std::generic_category(), "I/O buffer mmap");
+        }
+        if (ring != nullptr) {
+            std::vector<iovec> blocks(depth);
+            for (size_t i = 0; i < depth; ++i) {
+                blocks[i] = {block(i), blockBytes};
+            }
+            registered = ring->registerBuffers(blocks);
+        }
+    }
+
+    IoBuffers(const IoBuffers&) = delete;
+    IoBuffers& operator=(const IoBuffers&) = delete;
+
+    ~IoBuffers() {
+        ::munmap(base, blockBytes * depth);
+    }
+
+    char* block(size_t index) const {
+        return base + index * blockBytes;
+    }
+
+    // Buffer index to put in the SQE, or -1 to use the unregistered opcodes.
+    int registeredIndex(size_t index) const {
+        return registered ? static_cast<int>(index) : -1;
+    }
+};
+
+// Function to finish a partial transfer synchronously (short read or write, EAGAIN, EINTR).
+// Returns the bytes moved in total, stopping early only at end of file on a read.
+inline size_t completeTransfer(bool isWrite, int fd, char* data, size_t length, uint64_t offset, size_t done) {
+    while (done < length) {
+        ssize_t moved = isWrite ? ::pwrite(fd, data + done, length - done, static_cast<off_t>(offset + done))
+                                : ::pread(fd, data + done, length - done, static_cast<off_t>(offset + done));
+        if (moved < 0) {
+            if (errno == EINTR || errno == EAGAIN) {
+                continue;
+            }
+            throw std::system_error(errno, std::generic_category(), isWrite ? "pwrite" : "pread");
+        }
+        if (moved == 0) {
+            break;
+        }
+        done += static_cast<size_t>(moved);
+    }
+    return done;
+}
+
+inline bool retryable(int result) {
+    return result == -EAGAIN || result == -EINTR;
+}
+
+// Define the BlockReader class: a file read front to back in blockBytes blocks, readDepth of
+// them in flight. next() hands out blocks in file order; a block stays valid (and writable, as
+// JsonPack parses in place) until the following call, which recycles its buffer for a read
+// further ahead.
+class BlockReader {
+private:
+    struct Slot {
+        uint64_t offset = 0;
+        int result = 0;
+        bool pending = false;
+    };
+
+    int fd = -1;
+    IoConfig config;
+    uint64_t fileSize = 0;
+    std::unique_ptr<IoUring> ring;
+    std::unique_ptr<IoBuffers> buffers;
+    std::vector<Slot> slots;
+    uint64_t nextOffset = 0;    // file offset of the next read to issue
+    size_t current = 0;         // slot next() hands out next
+    bool holding = false;       // slots[current - 1] is with the caller
+    uint64_t consumed = 0;
+
+    void issue(size_t slot) {
+        Slot& s = slots[slot];
+        s.offset = nextOffset;
+        nextOffset += config.blockBytes;
+        size_t length = static_cast<size_t>(std::min<uint64_t>(config.blockBytes, fileSize - s.offset));
+        s.pending = true;
+        int registered = buffers->registeredIndex(slot);
+        ring->prepare(registered >= 0 ? IORING_OP_READ_FIXED : IORING_OP_READ, fd, buffers->block(slot), static_cast<unsigned>(length), s.offset,
+                      slot, registered);
+    }
+
+public:
+    explicit BlockReader(const std::string& path, IoConfig config = IoConfig{}) : config(config) {
+        this->config.readDepth = std::max(2u, config.readDepth);
+        fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            throw std::system_error(errno, std::generic_category(), "open " + path);
+        }
+        struct stat info;
+        if (::fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+            ::close(fd);
+            throw std::invalid_argument(path + " is not a regular file");
+        }
+        fileSize = static_cast<uint64_t>(info.st_size);
+        if (config.useUring && IoUring::supported()) {
+            ring = std::make_unique<IoUring>(this->config.readDepth);
+        }
+        buffers = std::make_unique<IoBuffers>(this->config.blockBytes, ring ? this->config.readDepth : 1, ring.get());
+        if (ring) {
+            ::posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+            slots.resize(this->config.readDepth);
+            for (size_t i = 0; i < slots.size() && nextOffset < fileSize; ++i) {
+                issue(i);
+            }
+            ring->submit();
+        }
+    }
+
+    BlockReader(const BlockReader&) = delete;
+    BlockReader& operator=(const BlockReader&) = delete;
+
+    ~BlockReader() {
+        if (ring) {
+            // The kernel may still be writing into our buffers; drain before unmapping them.
+            for (Slot& slot : slots) {
+                while (slot.pending) {
+                    uint64_t userData = 0;
+                    int result = 0;
+                    ring->waitComplete(userData, result);
+                    slots[userData].pending = false;
+                }
+            }
+        }
+        ::close(fd);
+    }
+
+    // Function to get the next block in file order; false at end of file.
+    bool next(char*& data, size_t& length) {
+        if (!ring) {
+            if (consumed >= fileSize) {
+                return false;
+            }
+            length = completeTransfer(false, fd, buffers->block(0), static_cast<size_t>(std::min<uint64_t>(config.blockBytes, fileSize - consumed)), consumed, 0);
+            data = buffers->block(0);
+            consumed += length;
+            return length > 0;
+        }
+
+        if (holding) {
+            size_t returned = (current + slots.size() - 1) % slots.size();
+            if (nextOffset < fileSize) {
+                issue(returned);
+                ring->submit();
+            }
+            holding = false;
+        }
+        Slot& slot = slots[current];
+        if (!slot.pending) {
+            return false;
+        }
+        while (slot.pending) {
+            uint64_t userData = 0;
+            int result = 0;
+            ring->waitComplete(userData, result);
+            slots[userData].result = result;
+            slots[userData].pending = false;
+        }
+        size_t expected = static_cast<size_t>(std::min<uint64_t>(config.blockBytes, fileSize - slot.offset));
+        if (slot.result < 0 && !retryable(slot.result)) {
+            throw std::system_error(-slot.result, std::generic_category(), "io_uring read");
+        }
+        length = completeTransfer(false, fd, buffers->block(current), expected, slot.offset, slot.result < 0 ? 0 : static_cast<size_t>(slot.result));
+        data = buffers->block(current);
+        consumed += length;
+        current = (current + 1) % slots.size();
+        holding = true;
+        return length > 0;
+    }
+
+    bool usingUring() const {
+        return static_cast<bool>(ring);
+    }
+
+    uint64_t bytesRead() const {
+        return consumed;
+    }
+};
+
+// Define the BlockWriter class: a std::streambuf whose put area is the current I/O buffer, so
+// an std::ostream formats straight into memory the kernel writes from. A full block is
+// submitted at its file offset and the next free buffer becomes the put area; up to
+// writeDepth blocks are in flight. An I/O error makes the stream bad and is rethrown by close().
+class BlockWriter : public std::streambuf {
+private:
+    int fd = -1;
+    IoConfig config;
+    std::unique_ptr<IoUring> ring;
+    std::unique_ptr<IoBuffers> buffers;
+    std::vector<uint64_t> slotOffsets;
+    std::vector<size_t> slotLengths;
+    std::vector<bool> slotPending;
+    size_t current = 0;
+    uint64_t fileOffset = 0;   // where the current buffer will be written
+    std::exception_ptr failure;
+    bool closed = false;
+
+    void reap(uint64_t userData, int result) {
+        size_t slot = static_cast<size_t>(userData);
+        slotPending[slot] = false;
+        if (result < 0 && !retryable(result)) {
+            throw std::system_error(-result, std::generic_category(), "io_uring write");
+        }
+        size_t written = result < 0 ? 0 : static_cast<size_t>(result);
+        if (written < slotLengths[slot]) {
+            completeTransfer(true, fd, buffers->block(slot), slotLengths[slot], slotOffsets[slot], written);
+        }
+    }
+
+    void waitFor(size_t slot) {
+        while (slotPending[slot]) {
+            uint64_t userData = 0;
+            int result = 0;
+            ring->waitComplete(userData, result);
+            reap(userData, result);
+        }
+    }
+
+    // Write out the put area and make the next buffer current.
+    void submitCurrent() {
+        size_t length = static_cast<size_t>(pptr() - pbase());
+        if (length > 0) {
+            if (!ring) {
+                completeTransfer(true, fd, pbase(), length, fileOffset, 0);
+            } else {
+                slotOffsets[current] = fileOffset;
+                slotLengths[current] = length;
+                slotPending[current] = true;
+                int registered = buffers->registeredIndex(current);
+                ring->prepare(registered >= 0 ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE, fd, pbase(), static_cast<unsigned>(length), fileOffset,
+                              current, registered);
+                ring->submit();
+                current = (current + 1) % slotPending.size();
+                waitFor(current);
+            }
+            fileOffset += length;
+        }
+        setp(buffers->block(current), buffers->block(current) + config.blockBytes);
+    }
+
+    void drain() {
+        if (ring) {
+            for (size_t slot = 0; slot < slotPending.size(); ++slot) {
+                waitFor(slot);
+            }
+        }
+    }
+
+protected:
+    int_type overflow(int_type ch) override {
+        if (failure) {
+            return traits_type::eof();
+        }
+        try {
+            submitCurrent();
+        } catch (...) {
+            failure = std::current_exception();
+            return traits_type::eof();
+        }
+        if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+            *pptr() = traits_type::to_char_type(ch);
+            pbump(1);
+        }
+        return traits_type::not_eof(ch);
+    }
+
+    // Submits what has been formatted so far without waiting for it; close() waits.
+    int sync() override {
+        return overflow(traits_type::eof()) == traits_type::eof() ? -1 : 0;
+    }
+
+public:
+    explicit BlockWriter(const std::string& path, IoConfig config = IoConfig{}) : config(config) {
+        this->config.writeDepth = std::max(2u, config.writeDepth);
+        fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            throw std::system_error(errno, std::generic_category(), "open " + path);
+        }
+        if (config.useUring && IoUring::supported()) {
+            ring = std::make_unique<IoUring>(this->config.writeDepth);
+        }
+        size_t depth = ring ? this->config.writeDepth : 1;
+        buffers = std::make_unique<IoBuffers>(this->config.blockBytes, depth, ring.get());
+        slotOffsets.resize(depth);
+        slotLengths.resize(depth);
+        slotPending.resize(depth);
+        setp(buffers->block(0), buffers->block(0) + this->config.blockBytes);
+    }
+
+    BlockWriter(const BlockWriter&) = delete;
+    BlockWriter& operator=(const BlockWriter&) = delete;
+
+    ~BlockWriter() override {
+        try {
+            close();
+        } catch (...) {
+            // Destructors must not throw; call close() to see write errors.
+        }
+        ::close(fd);
+    }
+
+    // Function to write out everything formatted so far and wait for it. Throws on I/O errors.
+    void close() {
+        if (closed) {
+            return;
+        }
+        closed = true;
+        if (!failure) {
+            try {
+                submitCurrent();
+                drain();
+            } catch (...) {
+                failure = std::current_exception();
+            }
+        } else {
+            try {
+                drain();
+            } catch (...) {
+            }
+        }
+        if (failure) {
+            std::rethrow_exception(failure);
+        }
+    }
+
+    bool usingUring() const {
+        return static_cast<bool>(ring);
+    }
+
+    uint64_t bytesWritten() const {
+        return fileOffset;
+    }
+};
+
+#endif // URING_IO_H
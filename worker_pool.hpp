@@ -0,0 +1,140 @@
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Define the WorkerPool class: a fixed set of threads that run short batches of tasks, so
+// per-record parallel work does not start and stop a thread per task.
+// runAll() runs tasks on the pool and on the calling thread together; the caller keeps
+// taking tasks itself, so a batch finishes even when every worker is busy (or is the caller).
+class WorkerPool {
+private:
+    struct Batch {
+        std::function<void(size_t)> task;
+        size_t count = 0;
+        std::atomic<size_t> next{0};
+        std::mutex mutex;
+        std::condition_variable finished;
+        size_t completed = 0;
+        std::exception_ptr failure;
+
+        // Run tasks until none are left; returns once this thread has nothing more to take.
+        void drain() {
+            for (size_t i = next.fetch_add(1); i < count; i = next.fetch_add(1)) {
+                std::exception_ptr error;
+                try {
+                    task(i);
+                } catch (...) {
+                    error = std::current_exception();
+                }
+                std::lock_guard<std::mutex> lock(mutex);
+                if (error && !failure) {
+                    failure = error;
+                }
+                if (++completed == count) {
+                    finished.notify_all();
+                }
+            }
+        }
+    };
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<std::shared_ptr<Batch>> queue;
+    std::vector<std::thread> workers;
+    bool stopping = false;
+
+    void workerLoop() {
+        for (;;) {
+            std::shared_ptr<Batch> batch;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this] { return stopping || !queue.empty(); });
+                if (queue.empty()) {
+                    return;
+                }
+                batch = std::move(queue.front());
+                queue.pop_front();
+            }
+            batch->drain();
+        }
+    }
+
+public:
+    explicit WorkerPool(size_t threads) {
+        threads = std::max<size_t>(1, threads);
+        workers.reserve(threads);
+        for (size_t i = 0; i < threads; ++i) {
+            workers.emplace_back([this] { workerLoop(); });
+        }
+    }
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    ~WorkerPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+
+    // One pool per process, sized to the machine, started on first use.
+    static WorkerPool& shared() {
+        static WorkerPool pool(std::max(2u, std::thread::hardware_concurrency()));
+        return pool;
+    }
+
+    size_t size() const {
+        return workers.size();
+    }
+
+    // Run task(0) .. task(count - 1), spread over the pool and the calling thread, and return
+    // once all have finished. The first exception a task throws is rethrown here.
+    template <typename Task>
+    void runAll(size_t count, Task&& task) {
+        if (count == 0) {
+            return;
+        }
+        auto batch = std::make_shared<Batch>();
+        batch->task = std::ref(task);
+        batch->count = count;
+        size_t helpers = std::min(count - 1, workers.size());
+        if (helpers > 0) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                for (size_t i = 0; i < helpers; ++i) {
+                    queue.push_back(batch);
+                }
+            }
+            if (helpers == 1) {
+                wake.notify_one();
+            } else {
+                wake.notify_all();
+            }
+        }
+        batch->drain();
+        // Workers that pick the batch up late find nothing left to take and never call task.
+        std::unique_lock<std::mutex> lock(batch->mutex);
+        batch->finished.wait(lock, [&] { return batch->completed == count; });
+        if (batch->failure) {
+            std::rethrow_exception(batch->failure);
+        }
+    }
+};
+
+#endif // WORKER_POOL_H